@@ -0,0 +1,420 @@
+// $Id: bigcheck.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// bigcheck -
+//    Randomized differential test and benchmark for bigint.  Every
+//    bigint operator, the radix conversions, and pow are run on
+//    random operands of several sizes and on edge cases (zero, one,
+//    carries across a limb, powers of 10 and of 2^32), and each
+//    result is compared with refbig, a slow decimal reference.
+//    Fixed cases for bugs found this way are checked first.
+//    Each mismatch is reported on cerr, and a table of test counts,
+//    mismatches, and times is printed on cout.  The exit status is
+//    nonzero if any result differed.
+//
+// Options:
+//    -@flags   set debug flags
+//    -n count  random operand pairs per size (default 10)
+//    -s seed   random seed (default 1)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <unistd.h>
+
+#include "bigint.h"
+#include "debug.h"
+#include "libfns.h"
+#include "refbig.h"
+#include "util.h"
+
+using check_clock = chrono::steady_clock;
+
+struct operand {
+   string text;
+   bigint ours;
+   refbig ref;
+   operand (const string& text_):
+            text (text_), ours (text_), ref (text_) {}
+};
+
+// op_stats -
+//    Counts and times for one operation.  comparable is false if the
+//    reference does no work like bigint's, as for decimal input,
+//    which refbig only copies, or the fixed cases, whose answers are
+//    constants, and then no ratio is printed.
+struct op_stats {
+   string name;
+   bool comparable {true};
+   size_t digits {0};
+   size_t tests {0};
+   size_t mismatches {0};
+   check_clock::duration ours_time {};
+   check_clock::duration ref_time {};
+};
+
+constexpr size_t MAX_REPORTED = 5;
+size_t random_count = 10;
+unsigned long random_seed = 1;
+mt19937_64 generator;
+
+string show (const bigint& value, int radix = 10) {
+   ostringstream out;
+   ubigint::output_radix (out, radix);
+   out << value;
+   return out.str();
+}
+
+string show (const refbig& value, int radix = 10) {
+   return value.to_radix (radix);
+}
+
+string show (const ubigint& value, int radix = 10) {
+   return value.to_radix (radix);
+}
+
+string show (bool value) {
+   return value ? "1" : "0";
+}
+
+string show (size_t value) {
+   return to_string (value);
+}
+
+string show (const string& value) {
+   return value;
+}
+
+// check -
+//    Time one operation on both implementations, compare the
+//    results as text, and count the test in stats.
+template <typename ours_fn, typename ref_fn>
+void check (op_stats& stats, const string& operands,
+            ours_fn ours, ref_fn ref) {
+   auto start = check_clock::now();
+   auto ours_result = ours();
+   auto middle = check_clock::now();
+   auto ref_result = ref();
+   auto finish = check_clock::now();
+   stats.ours_time += middle - start;
+   stats.ref_time += finish - middle;
+   ++stats.tests;
+   string ours_text = show (ours_result);
+   string ref_text = show (ref_result);
+   if (ours_text == ref_text) return;
+   if (++stats.mismatches <= MAX_REPORTED) {
+      error() << "mismatch: " << operands << " " << stats.name
+              << ": bigint " << ours_text << ", reference "
+              << ref_text << endl;
+   }
+}
+
+// ref_bitwise -
+//    Reference bitwise operation on the magnitudes, done on the
+//    binary digit strings.  The result is in binary.
+string ref_bitwise (const refbig& left, const refbig& right,
+                    char oper) {
+   string lbits = (left.is_negative() ? - left : left).to_radix (2);
+   string rbits = (right.is_negative() ? - right : right).to_radix (2);
+   size_t size = max (lbits.size(), rbits.size());
+   lbits.insert (0, size - lbits.size(), '0');
+   rbits.insert (0, size - rbits.size(), '0');
+   string result;
+   for (size_t index = 0; index < size; ++index) {
+      bool lbit = lbits[index] == '1';
+      bool rbit = rbits[index] == '1';
+      bool bit = oper == '&' ? lbit and rbit
+               : oper == '|' ? lbit or rbit : lbit != rbit;
+      result += bit ? '1' : '0';
+   }
+   size_t first = result.find ('1');
+   return first == string::npos ? "0" : result.substr (first);
+}
+
+// magnitude -
+//    The ubigint absolute value of an operand.
+ubigint magnitude (const operand& value) {
+   return ubigint (value.text[0] == '_' ? value.text.substr (1)
+                                        : value.text);
+}
+
+// check_pair -
+//    Run every binary operator on one pair of operands.
+void check_pair (vector<op_stats>& table, const operand& left,
+                 const operand& right) {
+   const bigint& lours = left.ours;
+   const bigint& rours = right.ours;
+   const refbig& lref = left.ref;
+   const refbig& rref = right.ref;
+   string operands = left.text + " " + right.text;
+   check (table[0], operands, [&]{ return lours + rours; },
+                              [&]{ return lref + rref; });
+   check (table[1], operands, [&]{ return lours - rours; },
+                              [&]{ return lref - rref; });
+   check (table[2], operands, [&]{ return lours * rours; },
+                              [&]{ return lref * rref; });
+   if (not rref.is_zero()) {
+      check (table[3], operands, [&]{ return lours / rours; },
+                                 [&]{ return lref / rref; });
+      check (table[4], operands, [&]{ return lours % rours; },
+                                 [&]{ return lref % rref; });
+   }
+   check (table[5], operands, [&]{ return lours == rours; },
+                              [&]{ return lref == rref; });
+   check (table[6], operands, [&]{ return lours < rours; },
+                              [&]{ return lref < rref; });
+   ubigint lmag = magnitude (left);
+   ubigint rmag = magnitude (right);
+   check (table[14], operands,
+          [&]{ return show (lmag & rmag, 2); },
+          [&]{ return ref_bitwise (lref, rref, '&'); });
+   check (table[15], operands,
+          [&]{ return show (lmag | rmag, 2); },
+          [&]{ return ref_bitwise (lref, rref, '|'); });
+   check (table[16], operands,
+          [&]{ return show (lmag ^ rmag, 2); },
+          [&]{ return ref_bitwise (lref, rref, '^'); });
+}
+
+// check_unary -
+//    Run the conversions and negation on one operand.
+void check_unary (vector<op_stats>& table, const operand& value) {
+   check (table[7], value.text, [&]{ return bigint (value.text); },
+                                [&]{ return refbig (value.text); });
+   check (table[8], value.text, [&]{ return show (value.ours, 16); },
+                                [&]{ return show (value.ref, 16); });
+   check (table[9], value.text, [&]{ return show (value.ours, 2); },
+                                [&]{ return show (value.ref, 2); });
+   check (table[10], value.text, [&]{ return show (value.ours, 7); },
+                                 [&]{ return show (value.ref, 7); });
+   string hex = value.ref.to_radix (16);
+   if (hex[0] == '-') hex[0] = '_';
+   check (table[11], hex, [&]{ return bigint (hex, 16); },
+                          [&]{ return refbig (hex, 16); });
+   check (table[12], value.text, [&]{ return - value.ours; },
+                                 [&]{ return - value.ref; });
+   uniform_int_distribution<size_t> shifts (0, 200);
+   size_t shift = shifts (generator);
+   refbig scale = pow (refbig ("2"), refbig (to_string (shift)));
+   string shifted = value.text + " " + to_string (shift);
+   check (table[17], shifted, [&]{ return value.ours << shift; },
+                              [&]{ return value.ref * scale; });
+   check (table[18], shifted, [&]{ return value.ours >> shift; },
+                              [&]{ return value.ref / scale; });
+   ubigint mag = magnitude (value);
+   check (table[19], value.text, [&]{ return mag.popcount(); },
+          [&]{
+             string bits = value.ref.to_radix (2);
+             return size_t (count (bits.begin(), bits.end(), '1'));
+          });
+}
+
+// check_pow -
+//    Raise the operand to a small exponent, keeping the result
+//    near a few thousand digits at most.
+void check_pow (vector<op_stats>& table, const operand& base) {
+   size_t digits = base.text.size();
+   uniform_int_distribution<long> exponents (-2, 2000 / digits + 2);
+   long exponent = exponents (generator);
+   if (base.ref.is_zero() and exponent < 0) exponent = - exponent;
+   string text = exponent < 0 ? "_" + to_string (- exponent)
+                              : to_string (exponent);
+   operand power (text);
+   check (table[13], base.text + " " + text,
+          [&]{ return pow (base.ours, power.ours); },
+          [&]{ return pow (base.ref, power.ref); });
+}
+
+// check_regressions -
+//    Fixed cases for bugs bigint once had, each checked against
+//    what dc prints:  subtraction of values of the same sign,
+//    negative zero, bigint (long) of a negative value, < of equal
+//    negatives, the sign of the remainder, and 0^0.
+void check_regressions (op_stats& stats) {
+   auto number = [] (const string& text) { return bigint (text); };
+   check (stats, "3 5 -", [&]{ return number ("3") - number ("5"); },
+                          [&]{ return string ("-2"); });
+   check (stats, "_3 _5 -",
+          [&]{ return number ("_3") - number ("_5"); },
+          [&]{ return string ("2"); });
+   check (stats, "_5 _5 -",
+          [&]{ return number ("_5") - number ("_5"); },
+          [&]{ return string ("0"); });
+   check (stats, "_0", [&]{ return number ("_0"); },
+                       [&]{ return string ("0"); });
+   check (stats, "_5 5 +", [&]{ return number ("_5") + number ("5"); },
+                           [&]{ return string ("0"); });
+   check (stats, "0 _1 *", [&]{ return number ("0") * number ("_1"); },
+                           [&]{ return string ("0"); });
+   check (stats, "bigint (-5)", [&]{ return bigint (-5L); },
+                                [&]{ return string ("-5"); });
+   check (stats, "bigint (LONG_MIN)",
+          [&]{ return bigint (numeric_limits<long>::min()); },
+          [&]{ return string ("-9223372036854775808"); });
+   check (stats, "_5 _5 <", [&]{ return number ("_5") < number ("_5"); },
+                            [&]{ return string ("0"); });
+   check (stats, "_3 _5 <", [&]{ return number ("_3") < number ("_5"); },
+                            [&]{ return string ("0"); });
+   check (stats, "_5 _3 <", [&]{ return number ("_5") < number ("_3"); },
+                            [&]{ return string ("1"); });
+   check (stats, "_7 3 %", [&]{ return number ("_7") % number ("3"); },
+                           [&]{ return string ("-1"); });
+   check (stats, "7 _3 %", [&]{ return number ("7") % number ("_3"); },
+                           [&]{ return string ("1"); });
+   check (stats, "0 0 ^",
+          [&]{ return pow (number ("0"), number ("0")); },
+          [&]{ return string ("1"); });
+}
+
+string random_number (size_t digits) {
+   uniform_int_distribution<int> digit (0, 9);
+   uniform_int_distribution<int> sign (0, 1);
+   string result = sign (generator) ? "_" : "";
+   result += static_cast<char> ('1' + digit (generator) % 9);
+   while (result.size() < digits + (result[0] == '_')) {
+      result += static_cast<char> ('0' + digit (generator));
+   }
+   return result;
+}
+
+// edge_cases -
+//    Zero, one, powers of ten and their predecessors, and powers of
+//    2^32 and their neighbours, which force carries and borrows
+//    across limbs.  Each nonzero case is also used negated.
+vector<string> edge_cases() {
+   vector<string> cases {"0", "1", "2"};
+   const refbig ONE ("1");
+   for (int power: {1, 9, 10, 19, 20}) {
+      refbig ten = pow (refbig ("10"), refbig (to_string (power)));
+      cases.push_back (ten.to_radix (10));
+      cases.push_back ((ten - ONE).to_radix (10));
+   }
+   for (int power: {32, 64, 96}) {
+      refbig two = pow (refbig ("2"), refbig (to_string (power)));
+      cases.push_back ((two - ONE).to_radix (10));
+      cases.push_back (two.to_radix (10));
+      cases.push_back ((two + ONE).to_radix (10));
+   }
+   size_t count = cases.size();
+   for (size_t index = 1; index < count; ++index) {
+      cases.push_back ("_" + cases[index]);
+   }
+   return cases;
+}
+
+vector<op_stats> new_table (size_t digits) {
+   vector<op_stats> table;
+   for (string name: {"+", "-", "*", "/", "%", "==", "<", "input",
+                      "print16", "print2", "print7", "input16",
+                      "negate", "^", "&", "|", "xor", "<<", ">>",
+                      "popcount"}) {
+      op_stats stats;
+      stats.name = name;
+      stats.comparable = name != "input";
+      stats.digits = digits;
+      table.push_back (stats);
+   }
+   return table;
+}
+
+void print_table (const vector<op_stats>& table, const string& size) {
+   for (const auto& stats: table) {
+      if (stats.tests == 0) continue;
+      double ours = chrono::duration<double, milli> (stats.ours_time)
+                    .count();
+      double ref = chrono::duration<double, milli> (stats.ref_time)
+                   .count();
+      cout << setw (8) << stats.name << setw (8) << size
+           << setw (8) << stats.tests << setw (11) << stats.mismatches
+           << fixed << setprecision (3)
+           << setw (12) << ours << setw (12) << ref
+           << setprecision (1) << setw (9);
+      if (stats.comparable) {
+         cout << (ours > 0 ? ref / ours : 0);
+      }else {
+         cout << "-";
+      }
+      cout << endl;
+   }
+}
+
+void scan_options (int argc, char** argv) {
+   opterr = 0;
+   for (;;) {
+      int option = getopt (argc, argv, "@:n:s:");
+      if (option == EOF) break;
+      switch (option) {
+         case '@':
+            debugflags::setflags (optarg);
+            break;
+         case 'n':
+            random_count = strtoul (optarg, nullptr, 10);
+            break;
+         case 's':
+            random_seed = strtoul (optarg, nullptr, 10);
+            break;
+         default:
+            error() << "-" << static_cast<char> (optopt)
+                    << ": invalid option" << endl;
+            break;
+      }
+   }
+   if (optind < argc) {
+      error() << "operand not permitted" << endl;
+   }
+}
+
+int main (int argc, char** argv) {
+   exec::execname (argv[0]);
+   scan_options (argc, argv);
+   generator.seed (random_seed);
+   cout << setw (8) << "op" << setw (8) << "digits" << setw (8)
+        << "tests" << setw (11) << "mismatches" << setw (12)
+        << "bigint ms" << setw (12) << "ref ms" << setw (9) << "ratio"
+        << endl;
+
+   vector<op_stats> regressions (1);
+   regressions[0].name = "regress";
+   regressions[0].comparable = false;
+   check_regressions (regressions[0]);
+   print_table (regressions, "fixed");
+
+   vector<operand> edges;
+   for (const auto& text: edge_cases()) edges.emplace_back (text);
+   vector<op_stats> edge_table = new_table (0);
+   for (const auto& left: edges) {
+      check_unary (edge_table, left);
+      check_pow (edge_table, left);
+      for (const auto& right: edges) {
+         check_pair (edge_table, left, right);
+      }
+   }
+   print_table (edge_table, "edge");
+
+   for (size_t digits: {1, 5, 10, 20, 40, 100, 300, 1000}) {
+      vector<op_stats> table = new_table (digits);
+      uniform_int_distribution<size_t> right_digits (1, digits);
+      for (size_t count = 0; count < random_count; ++count) {
+         operand left (random_number (digits));
+         operand right (random_number (right_digits (generator)));
+         check_pair (table, left, right);
+         check_pair (table, right, left);
+         check_unary (table, left);
+         check_pow (table, left);
+      }
+      print_table (table, to_string (digits));
+   }
+   return exec::status();
+}
+
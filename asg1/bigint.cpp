@@ -12,17 +12,23 @@ using namespace std;
 #include "debug.h"
 #include "relops.h"
 
-bigint::bigint (long that): uvalue (that), is_negative (that < 0) {
+bigint::bigint (long that):
+                uvalue (that < 0 ? - static_cast<unsigned long> (that)
+                                 : static_cast<unsigned long> (that)),
+                is_negative (that < 0) {
    DEBUGF ('~', this << " -> " << uvalue)
 }
 
-bigint::bigint (const ubigint& uvalue, bool is_negative):
-                uvalue(uvalue), is_negative(is_negative) {
+// Zero is never negative, so there is only one way to write it.
+bigint::bigint (const ubigint& uvalue_, bool is_negative_):
+                uvalue(uvalue_),
+                is_negative(is_negative_ and uvalue_ != ubigint()) {
 }
 
-bigint::bigint (const string& that) {
+bigint::bigint (const string& that, int radix) {
    is_negative = that.size() > 0 and that[0] == '_';
-   uvalue = ubigint (that.substr (is_negative ? 1 : 0));
+   uvalue = ubigint (that.substr (is_negative ? 1 : 0), radix);
+   if (uvalue == ubigint()) is_negative = false;
 }
 
 bigint bigint::operator+ () const {
@@ -47,18 +53,7 @@ bigint bigint::operator+ (const bigint& that) const {
 }
 
 bigint bigint::operator- (const bigint& that) const {
-   if (is_negative == that.is_negative) {
-       return {uvalue + that.uvalue, is_negative};
-   }
-   if (is_negative == that.is_negative) {
-      if (uvalue == that.uvalue) {
-         return {ubigint(0), false};
-      } else if (uvalue < that.uvalue) {
-         return {that.uvalue - uvalue, not is_negative};
-      } else {
-          return {uvalue - that.uvalue, is_negative};
-      }
-   }
+   return *this + - that;
 }
 
 
@@ -76,11 +71,17 @@ bigint bigint::operator/ (const bigint& that) const {
    return {uvalue / that.uvalue, true};
 }
 
+// As in dc, the remainder has the sign of the dividend.
 bigint bigint::operator% (const bigint& that) const {
-   if (is_negative == that.is_negative) {
-      return {uvalue % that.uvalue, false};
-   }
-   return {uvalue % that.uvalue, true};
+   return {uvalue % that.uvalue, is_negative};
+}
+
+bigint bigint::operator<< (size_t bits) const {
+   return {uvalue << bits, is_negative};
+}
+
+bigint bigint::operator>> (size_t bits) const {
+   return {uvalue >> bits, is_negative};
 }
 
 bool bigint::operator== (const bigint& that) const {
@@ -96,12 +97,30 @@ bool bigint::operator< (const bigint& that) const {
       return is_negative;
     }
     if (is_negative) {
-        return !(uvalue < that.uvalue);
+        return that.uvalue < uvalue;
     } else {
         return uvalue < that.uvalue;
     }
 }
 
+size_t bigint::hash() const {
+   return uvalue.hash() ^ (is_negative ? 0x9e3779b97f4a7c15ul : 0);
+}
+
+size_t bigint::bytes() const {
+   return sizeof (bigint) - sizeof (ubigint) + uvalue.bytes();
+}
+
+long bigint::to_long() const {
+   unsigned long magnitude = uvalue.to_ulong();
+   if (magnitude > static_cast<unsigned long> (
+                   numeric_limits<long>::max())) {
+      throw overflow_error ("bigint::to_long");
+   }
+   long result = static_cast<long> (magnitude);
+   return is_negative ? - result : result;
+}
+
 ostream& operator<< (ostream& out, const bigint& that) {
    return out << (that.is_negative ? "-" : "") << that.uvalue;
 }
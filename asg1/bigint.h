@@ -23,7 +23,7 @@ class bigint {
       bigint() = default; // Needed or will be suppressed.
       bigint (long);
       bigint (const ubigint&, bool is_negative = false);
-      explicit bigint (const string&);
+      explicit bigint (const string&, int radix = 10);
 
       bigint operator+() const;
       bigint operator-() const;
@@ -34,8 +34,17 @@ class bigint {
       bigint operator/ (const bigint&) const;
       bigint operator% (const bigint&) const;
 
+      // Shifts scale the magnitude by 2^bits, truncating toward
+      // zero like operator/.
+      bigint operator<< (size_t bits) const;
+      bigint operator>> (size_t bits) const;
+
       bool operator== (const bigint&) const;
       bool operator<  (const bigint&) const;
+
+      size_t hash() const;
+      size_t bytes() const;
+      long to_long() const;
 };
 
 #endif
@@ -14,6 +14,7 @@ bigint pow (const bigint& base_arg, const bigint& exponent_arg) {
    static const bigint ONE (1);
    static const bigint TWO (2);
    DEBUGF ('^', "base = " << base << ", exponent = " << exponent);
+   if (exponent == ZERO) return ONE;
    if (base == ZERO) return ZERO;
    bigint result = ONE;
    if (exponent < ZERO) {
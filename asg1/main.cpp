@@ -1,11 +1,19 @@
 // $Id: main.cpp,v 1.58 2019-04-05 16:29:31-07 - - $
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 using namespace std;
 
 #include <unistd.h>
@@ -14,12 +22,27 @@ using namespace std;
 #include "debug.h"
 #include "iterstack.h"
 #include "libfns.h"
+#include "opcache.h"
 #include "scanner.h"
 #include "util.h"
 
 using bigint_stack = iterstack<bigint>;
 
-void do_arith (bigint_stack& stack, const char oper) {
+// shift_count -
+//    Convert the right operand of H or h to a number of bits.  The
+//    count is limited so that a typo cannot ask for a result of
+//    gigabytes.
+constexpr long MAX_SHIFT_BITS = 1L << 24;
+size_t shift_count (const bigint& count) {
+   if (count < bigint (0)) throw ydc_exn ("negative shift count");
+   if (bigint (MAX_SHIFT_BITS) < count) {
+      throw ydc_exn ("shift count larger than "
+                     + to_string (MAX_SHIFT_BITS));
+   }
+   return count.to_long();
+}
+
+void do_arith (bigint_stack& stack, ostream&, const char oper) {
    if (stack.size() < 2) throw ydc_exn ("stack empty");
    bigint right = stack.top();
    stack.pop();
@@ -28,6 +51,12 @@ void do_arith (bigint_stack& stack, const char oper) {
    stack.pop();
    DEBUGF ('d', "left = " << left);
    bigint result;
+   bool cacheable = oper == '*' or oper == '/' or oper == '%'
+                 or oper == '^';
+   if (cacheable and opcache::lookup (oper, left, right, result)) {
+      stack.push (result);
+      return;
+   }
    switch (oper) {
       case '+': result = left + right; break;
       case '-': result = left - right; break;
@@ -35,56 +64,104 @@ void do_arith (bigint_stack& stack, const char oper) {
       case '/': result = left / right; break;
       case '%': result = left % right; break;
       case '^': result = pow (left, right); break;
+      case 'H': result = left << shift_count (right); break;
+      case 'h': result = left >> shift_count (right); break;
       default: throw invalid_argument ("do_arith operator "s + oper);
    }
    DEBUGF ('d', "result = " << result);
+   if (cacheable) opcache::insert (oper, left, right, result);
    stack.push (result);
 }
 
-void do_clear (bigint_stack& stack, const char) {
+void do_clear (bigint_stack& stack, ostream&, const char) {
    DEBUGF ('d', "");
    stack.clear();
 }
 
 
-void do_dup (bigint_stack& stack, const char) {
+void do_dup (bigint_stack& stack, ostream&, const char) {
    bigint top = stack.top();
    DEBUGF ('d', top);
    stack.push (top);
 }
 
-void do_printall (bigint_stack& stack, const char) {
-   for (const auto& elem: stack) cout << elem << endl;
+void do_printall (bigint_stack& stack, ostream& out, const char) {
+   for (const auto& elem: stack) out << elem << "\n";
+}
+
+void do_print (bigint_stack& stack, ostream& out, const char) {
+   if (stack.size() < 1) throw ydc_exn ("stack empty");
+   out << stack.top() << "\n";
+}
+
+void do_debug (bigint_stack&, ostream& out, const char) {
+   opcache::print_stats (out);
 }
 
-void do_print (bigint_stack& stack, const char) {
+// pop_radix -
+//    Pop the top of the stack as a radix for the i and o commands.
+int pop_radix (bigint_stack& stack) {
    if (stack.size() < 1) throw ydc_exn ("stack empty");
-   cout << stack.top() << endl;
+   bigint radix = stack.top();
+   if (radix < bigint (ubigint::MIN_RADIX)
+    or radix > bigint (ubigint::MAX_RADIX)) {
+      throw ydc_exn ("radix must be between "
+                     + to_string (ubigint::MIN_RADIX) + " and "
+                     + to_string (ubigint::MAX_RADIX));
+   }
+   stack.pop();
+   return radix.to_long();
+}
+
+void do_iradix (bigint_stack& stack, scanner& input) {
+   input.radix (pop_radix (stack));
+   DEBUGF ('d', "input radix = " << input.radix());
+}
+
+void do_oradix (bigint_stack& stack, ostream& out) {
+   ubigint::output_radix (out, pop_radix (stack));
+   DEBUGF ('d', "output radix = " << ubigint::output_radix (out));
 }
 
-void do_debug (bigint_stack&, const char) {
-   cout << "Y not implemented" << endl;
+void do_push_iradix (bigint_stack& stack, scanner& input) {
+   stack.push (bigint (input.radix()));
+}
+
+void do_push_oradix (bigint_stack& stack, ostream& out) {
+   stack.push (bigint (ubigint::output_radix (out)));
 }
 
 class ydc_quit: public exception {};
-void do_quit (bigint_stack&, const char) {
+void do_quit (bigint_stack&, ostream&, const char) {
    throw ydc_quit();
 }
 
-void do_function (bigint_stack& stack, const char oper) {
+// do_function -
+//    Run one command.  H and h shift left and right by a number of
+//    bits, as in Gavin Howard's dc; < and >, which are conditional
+//    execution in dc, are left unimplemented.  Like I and O, H scans
+//    as a digit when the input radix is above 17.
+void do_function (bigint_stack& stack, scanner& input, ostream& out,
+                  const char oper) {
    switch (oper) {
-      case '+': do_arith    (stack, oper); break;
-      case '-': do_arith    (stack, oper); break;
-      case '*': do_arith    (stack, oper); break;
-      case '/': do_arith    (stack, oper); break;
-      case '%': do_arith    (stack, oper); break;
-      case '^': do_arith    (stack, oper); break;
-      case 'Y': do_debug    (stack, oper); break;
-      case 'c': do_clear    (stack, oper); break;
-      case 'd': do_dup      (stack, oper); break;
-      case 'f': do_printall (stack, oper); break;
-      case 'p': do_print    (stack, oper); break;
-      case 'q': do_quit     (stack, oper); break;
+      case '+': do_arith    (stack, out, oper); break;
+      case '-': do_arith    (stack, out, oper); break;
+      case '*': do_arith    (stack, out, oper); break;
+      case '/': do_arith    (stack, out, oper); break;
+      case '%': do_arith    (stack, out, oper); break;
+      case '^': do_arith    (stack, out, oper); break;
+      case 'H': do_arith    (stack, out, oper); break;
+      case 'I': do_push_iradix (stack, input); break;
+      case 'O': do_push_oradix (stack, out); break;
+      case 'Y': do_debug    (stack, out, oper); break;
+      case 'c': do_clear    (stack, out, oper); break;
+      case 'd': do_dup      (stack, out, oper); break;
+      case 'f': do_printall (stack, out, oper); break;
+      case 'h': do_arith    (stack, out, oper); break;
+      case 'i': do_iradix   (stack, input); break;
+      case 'o': do_oradix   (stack, out); break;
+      case 'p': do_print    (stack, out, oper); break;
+      case 'q': do_quit     (stack, out, oper); break;
       default : throw ydc_exn (octal (oper) + " is unimplemented");
    }
 }
@@ -92,37 +169,48 @@ void do_function (bigint_stack& stack, const char oper) {
 
 //
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:  -@flags sets debug flags, and -c bytes
+//    enables the operation cache with the given byte budget.
+//    Any operands are script files to be run as a batch.
 //
-void scan_options (int argc, char** argv) {
+vector<string> scan_options (int argc, char** argv) {
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:c:");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'c': {
+            char* endptr = nullptr;
+            unsigned long bytes = strtoul (optarg, &endptr, 10);
+            if (*optarg == '\0' or *endptr != '\0') {
+               error() << "-c " << optarg << ": invalid cache size"
+                       << endl;
+            }else {
+               opcache::set_budget (bytes);
+            }
+            break;
+            }
          default:
             error() << "-" << static_cast<char> (optopt)
                     << ": invalid option" << endl;
             break;
       }
    }
-   if (optind < argc) {
-      error() << "operand not permitted" << endl;
-   }
+   return vector<string> (argv + optind, argv + argc);
 }
 
-
+
 //
-// Main function.
+// run_script
+//    Scan and execute one script with its own operand stack,
+//    writing everything it prints to out.
 //
-int main (int argc, char** argv) {
-   exec::execname (argv[0]);
-   scan_options (argc, argv);
+void run_script (istream& instream, ostream& out) {
    bigint_stack operand_stack;
-   scanner input;
+   scanner input (instream);
    try {
       for (;;) {
          try {
@@ -132,23 +220,86 @@ int main (int argc, char** argv) {
                   throw ydc_quit();
                   break;
                case tsymbol::NUMBER:
-                  operand_stack.push (bigint (lexeme.lexinfo));
+                  operand_stack.push (bigint (lexeme.lexinfo,
+                                              input.radix()));
                   break;
                case tsymbol::OPERATOR: {
                   char oper = lexeme.lexinfo[0];
-                  do_function (operand_stack, oper);
+                  do_function (operand_stack, input, out, oper);
                   break;
                   }
                default:
                   assert (false);
             }
          }catch (ydc_exn& exn) {
-            cout << exn.what() << endl;
+            out << exn.what() << "\n";
          }
       }
    }catch (ydc_quit&) {
       // Intentionally left empty.
    }
-   return exec::status();
 }
 
+
+//
+// run_batch
+//    Run each script file on a pool of worker threads.  Each script
+//    prints into its own buffer, and the buffers are written to
+//    cout in the order the files were named, so the output is the
+//    same as running the scripts one after another.
+//
+struct batch_script {
+   string filename;
+   ostringstream output;
+   int open_errno {0};
+};
+
+void run_batch (const vector<string>& filenames) {
+   vector<batch_script> scripts (filenames.size());
+   for (size_t index = 0; index < filenames.size(); ++index) {
+      scripts[index].filename = filenames[index];
+   }
+   atomic<size_t> next_script {0};
+   auto worker = [&scripts, &next_script]() {
+      for (;;) {
+         size_t index = next_script++;
+         if (index >= scripts.size()) break;
+         batch_script& script = scripts[index];
+         ifstream infile (script.filename);
+         if (infile.fail()) {
+            script.open_errno = errno;
+            continue;
+         }
+         run_script (infile, script.output);
+      }
+   };
+   size_t nworkers = max (1u, thread::hardware_concurrency());
+   if (nworkers > scripts.size()) nworkers = scripts.size();
+   DEBUGF ('b', "scripts = " << scripts.size()
+          << ", workers = " << nworkers);
+   vector<thread> workers;
+   for (size_t count = 0; count < nworkers; ++count) {
+      workers.emplace_back (worker);
+   }
+   for (auto& worker_thread: workers) worker_thread.join();
+   for (const auto& script: scripts) {
+      if (script.open_errno != 0) {
+         error() << script.filename << ": "
+                 << strerror (script.open_errno) << endl;
+      }else {
+         cout << script.output.str();
+      }
+   }
+}
+
+
+//
+// Main function.
+//
+int main (int argc, char** argv) {
+   exec::execname (argv[0]);
+   vector<string> filenames = scan_options (argc, argv);
+   if (filenames.empty()) run_script (cin, cout);
+                     else run_batch (filenames);
+   return exec::status();
+}
@@ -0,0 +1,101 @@
+// $Id: opcache.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <iostream>
+#include <mutex>
+using namespace std;
+
+#include "debug.h"
+#include "opcache.h"
+
+mutex opcache::lock;
+opcache::lru_list opcache::lru;
+opcache::index_map opcache::index;
+size_t opcache::budget {0};
+size_t opcache::used {0};
+size_t opcache::hits {0};
+size_t opcache::misses {0};
+size_t opcache::evictions {0};
+
+size_t opcache::fingerprint (char oper, const bigint& left,
+                             const bigint& right) {
+   size_t result = left.hash();
+   result ^= right.hash() + 0x9e3779b97f4a7c15ul
+           + (result << 6) + (result >> 2);
+   return result * 31 + static_cast<unsigned char> (oper);
+}
+
+// evict -
+//    Drop least recently used entries until within budget.
+//    Caller must hold the lock.
+void opcache::evict() {
+   while (used > budget and not lru.empty()) {
+      const entry& victim = lru.back();
+      auto range = index.equal_range (victim.fingerprint);
+      for (auto itor = range.first; itor != range.second; ++itor) {
+         if (&*itor->second == &victim) {
+            index.erase (itor);
+            break;
+         }
+      }
+      used -= victim.bytes;
+      lru.pop_back();
+      ++evictions;
+   }
+}
+
+void opcache::set_budget (size_t bytes) {
+   lock_guard<mutex> guard (lock);
+   budget = bytes;
+   evict();
+   DEBUGF ('m', "budget = " << budget);
+}
+
+bool opcache::lookup (char oper, const bigint& left,
+                      const bigint& right, bigint& result) {
+   if (not enabled()) return false;
+   size_t key = fingerprint (oper, left, right);
+   lock_guard<mutex> guard (lock);
+   auto range = index.equal_range (key);
+   for (auto itor = range.first; itor != range.second; ++itor) {
+      const entry& found = *itor->second;
+      if (found.oper == oper and found.left == left
+      and found.right == right) {
+         lru.splice (lru.begin(), lru, itor->second);
+         result = found.result;
+         ++hits;
+         DEBUGF ('m', "hit " << left << " " << right << " " << oper);
+         return true;
+      }
+   }
+   ++misses;
+   DEBUGF ('m', "miss " << left << " " << right << " " << oper);
+   return false;
+}
+
+void opcache::insert (char oper, const bigint& left,
+                      const bigint& right, const bigint& result) {
+   if (not enabled()) return;
+   size_t bytes = sizeof (entry) + left.bytes() + right.bytes()
+                + result.bytes();
+   if (bytes > budget) return;
+   size_t key = fingerprint (oper, left, right);
+   lock_guard<mutex> guard (lock);
+   auto range = index.equal_range (key);
+   for (auto itor = range.first; itor != range.second; ++itor) {
+      const entry& found = *itor->second;
+      if (found.oper == oper and found.left == left
+      and found.right == right) return;
+   }
+   lru.push_front ({oper, left, right, result, key, bytes});
+   index.emplace (key, lru.begin());
+   used += bytes;
+   evict();
+}
+
+void opcache::print_stats (ostream& out) {
+   lock_guard<mutex> guard (lock);
+   out << "opcache: hits " << hits << ", misses " << misses
+       << ", evictions " << evictions << ", entries " << lru.size()
+       << ", bytes " << used << "/" << budget << "\n";
+}
+
@@ -0,0 +1,70 @@
+// $Id: opcache.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// opcache -
+//    Static class holding an opt-in memo of results of expensive
+//    bigint operations.  Entries are keyed by the operator and the
+//    fingerprints (bigint::hash) of both operands, and the operands
+//    themselves are kept so a fingerprint collision is never
+//    reported as a hit.  Least recently used entries are evicted
+//    once the memory held exceeds the byte budget.  A budget of 0
+//    (the default) disables the cache.  The cache is shared by all
+//    batch worker threads and is protected by a mutex.
+//
+// set_budget -
+//    Set the maximum number of bytes held by cached entries.
+// lookup -
+//    If (oper, left, right) is cached, copy its value into result,
+//    mark it most recently used, and return true.
+// insert -
+//    Remember the result of (oper, left, right).
+// print_stats -
+//    Print hit, miss, and eviction counts and memory use.
+//
+
+#ifndef __OPCACHE_H__
+#define __OPCACHE_H__
+
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+using namespace std;
+
+#include "bigint.h"
+
+class opcache {
+   private:
+      struct entry {
+         char oper;
+         bigint left;
+         bigint right;
+         bigint result;
+         size_t fingerprint;
+         size_t bytes;
+      };
+      using lru_list = list<entry>;
+      using index_map = unordered_multimap<size_t,lru_list::iterator>;
+      static mutex lock;
+      static lru_list lru;
+      static index_map index;
+      static size_t budget;
+      static size_t used;
+      static size_t hits;
+      static size_t misses;
+      static size_t evictions;
+      static size_t fingerprint (char oper, const bigint& left,
+                                 const bigint& right);
+      static void evict();
+   public:
+      static void set_budget (size_t bytes);
+      static bool enabled() { return budget > 0; }
+      static bool lookup (char oper, const bigint& left,
+                          const bigint& right, bigint& result);
+      static void insert (char oper, const bigint& left,
+                          const bigint& right, const bigint& result);
+      static void print_stats (ostream& out);
+};
+
+#endif
+
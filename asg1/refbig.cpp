@@ -0,0 +1,200 @@
+// $Id: refbig.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+#include "refbig.h"
+
+// strip_zeros -
+//    Remove leading zeros, leaving "0" for zero.
+static string strip_zeros (const string& digits) {
+   size_t first = digits.find_first_not_of ('0');
+   if (first == string::npos) return "0";
+   return digits.substr (first);
+}
+
+refbig::refbig (bool negative_, const string& digits_):
+                negative (negative_), digits (strip_zeros (digits_)) {
+   if (is_zero()) negative = false;
+}
+
+refbig::refbig (const string& dc_number, int radix) {
+   string magnitude = dc_number;
+   if (magnitude.size() > 0 and magnitude[0] == '_') {
+      negative = true;
+      magnitude = magnitude.substr (1);
+   }
+   string radix_digits = to_string (radix);
+   string result = "0";
+   for (char digit: magnitude) {
+      int value = isdigit (digit) ? digit - '0'
+                : isupper (digit) and radix != 10 ? digit - 'A' + 10
+                : -1;
+      if (value < 0) {
+         throw invalid_argument ("refbig::refbig(" + dc_number + ")");
+      }
+      if (radix == 10) continue;
+      result = add_digits (mul_digits (result, radix_digits),
+                           to_string (value));
+   }
+   digits = strip_zeros (radix == 10 ? magnitude : result);
+   if (is_zero()) negative = false;
+}
+
+int refbig::compare_digits (const string& left, const string& right) {
+   if (left.size() != right.size()) {
+      return left.size() < right.size() ? -1 : 1;
+   }
+   return left.compare (right) < 0 ? -1 : left == right ? 0 : 1;
+}
+
+string refbig::add_digits (const string& left, const string& right) {
+   string result;
+   int carry = 0;
+   auto litor = left.crbegin();
+   auto ritor = right.crbegin();
+   while (litor != left.crend() or ritor != right.crend() or carry) {
+      int sum = carry;
+      if (litor != left.crend()) sum += *litor++ - '0';
+      if (ritor != right.crend()) sum += *ritor++ - '0';
+      result += static_cast<char> ('0' + sum % 10);
+      carry = sum / 10;
+   }
+   reverse (result.begin(), result.end());
+   return strip_zeros (result);
+}
+
+// sub_digits -
+//    left - right, where left >= right.
+string refbig::sub_digits (const string& left, const string& right) {
+   string result;
+   int borrow = 0;
+   auto ritor = right.crbegin();
+   for (auto litor = left.crbegin(); litor != left.crend(); ++litor) {
+      int diff = *litor - '0' - borrow;
+      if (ritor != right.crend()) diff -= *ritor++ - '0';
+      borrow = diff < 0;
+      if (borrow) diff += 10;
+      result += static_cast<char> ('0' + diff);
+   }
+   reverse (result.begin(), result.end());
+   return strip_zeros (result);
+}
+
+string refbig::mul_digits (const string& left, const string& right) {
+   vector<int> product (left.size() + right.size(), 0);
+   for (size_t lpos = 0; lpos < left.size(); ++lpos) {
+      for (size_t rpos = 0; rpos < right.size(); ++rpos) {
+         product[lpos + rpos + 1] += (left[lpos] - '0')
+                                   * (right[rpos] - '0');
+      }
+   }
+   for (size_t pos = product.size() - 1; pos > 0; --pos) {
+      product[pos - 1] += product[pos] / 10;
+      product[pos] %= 10;
+   }
+   string result;
+   for (int digit: product) result += static_cast<char> ('0' + digit);
+   return strip_zeros (result);
+}
+
+// divide_digits -
+//    Long division, finding each quotient digit by repeated
+//    subtraction.  Returns the quotient and the remainder.
+pair<string,string> refbig::divide_digits (const string& dividend,
+                                           const string& divisor) {
+   if (divisor == "0") throw domain_error ("refbig divide by zero");
+   string quotient;
+   string remainder = "0";
+   for (char digit: dividend) {
+      remainder = strip_zeros (remainder + digit);
+      char quotient_digit = '0';
+      while (compare_digits (remainder, divisor) >= 0) {
+         remainder = sub_digits (remainder, divisor);
+         ++quotient_digit;
+      }
+      quotient += quotient_digit;
+   }
+   return {strip_zeros (quotient), remainder};
+}
+
+refbig refbig::operator- () const {
+   return {not negative, digits};
+}
+
+refbig refbig::operator+ (const refbig& that) const {
+   if (negative == that.negative) {
+      return {negative, add_digits (digits, that.digits)};
+   }
+   if (compare_digits (digits, that.digits) >= 0) {
+      return {negative, sub_digits (digits, that.digits)};
+   }
+   return {that.negative, sub_digits (that.digits, digits)};
+}
+
+refbig refbig::operator- (const refbig& that) const {
+   return *this + - that;
+}
+
+refbig refbig::operator* (const refbig& that) const {
+   return {negative != that.negative, mul_digits (digits, that.digits)};
+}
+
+refbig refbig::operator/ (const refbig& that) const {
+   return {negative != that.negative,
+           divide_digits (digits, that.digits).first};
+}
+
+refbig refbig::operator% (const refbig& that) const {
+   return {negative, divide_digits (digits, that.digits).second};
+}
+
+bool refbig::operator== (const refbig& that) const {
+   return negative == that.negative and digits == that.digits;
+}
+
+bool refbig::operator< (const refbig& that) const {
+   if (negative != that.negative) return negative;
+   int compare = compare_digits (digits, that.digits);
+   return negative ? compare > 0 : compare < 0;
+}
+
+string refbig::to_radix (int radix) const {
+   static const string DIGITS = "0123456789ABCDEFGHIJKLMNOPQRSTUV";
+   string result;
+   string quotient = digits;
+   while (quotient != "0") {
+      string next;
+      int remainder = 0;
+      for (char digit: quotient) {
+         remainder = remainder * 10 + digit - '0';
+         next += static_cast<char> ('0' + remainder / radix);
+         remainder %= radix;
+      }
+      result += DIGITS[remainder];
+      quotient = strip_zeros (next);
+   }
+   if (result.empty()) result = "0";
+   if (negative) result += '-';
+   reverse (result.begin(), result.end());
+   return result;
+}
+
+refbig pow (const refbig& base, const refbig& exponent) {
+   static const refbig ONE ("1");
+   if (exponent.negative) {
+      if (base.is_zero()) throw domain_error ("refbig pow of zero");
+      if (base.digits != "1") return {};
+      return exponent.digits.back() % 2 == 0 ? ONE : base;
+   }
+   refbig result = ONE;
+   for (refbig count = exponent; not count.is_zero();
+        count = count - ONE) {
+      result = result * base;
+   }
+   return result;
+}
+
@@ -0,0 +1,68 @@
+// $Id: refbig.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// refbig -
+//    Deliberately slow and simple signed decimal arithmetic, used
+//    only by bigcheck as a reference to cross-check bigint.  The
+//    magnitude is a string of decimal digits, most significant
+//    first, with no leading zeros, and zero is "0" and never
+//    negative.  Everything is done the way it is done by hand, one
+//    digit at a time, so it shares no code or representation with
+//    ubigint.
+//
+// refbig (const string&, int radix) -
+//    Takes a number in dc notation, with _ as the minus sign, and
+//    digits 0-9 and A-Z in the given radix.  Other radices are
+//    converted by hand, multiplying by the radix and adding each
+//    digit in decimal.
+// operator/ and operator% -
+//    Truncate toward zero, and the remainder has the sign of the
+//    dividend, as in dc.
+// pow -
+//    Integer power with the exponent truncated as in dc, so that
+//    a negative exponent gives 1 / base^-exponent truncated.
+// to_radix -
+//    Digits in the given radix, with a leading - if negative.
+//
+
+#ifndef __REFBIG_H__
+#define __REFBIG_H__
+
+#include <string>
+#include <utility>
+using namespace std;
+
+class refbig {
+   private:
+      bool negative {false};
+      string digits {"0"};
+      refbig (bool negative, const string& digits);
+      static int compare_digits (const string&, const string&);
+      static string add_digits (const string&, const string&);
+      static string sub_digits (const string&, const string&);
+      static string mul_digits (const string&, const string&);
+      static pair<string,string> divide_digits (const string&,
+                                                const string&);
+   public:
+      refbig() = default;
+      explicit refbig (const string& dc_number, int radix = 10);
+
+      bool is_zero() const { return digits == "0"; }
+      bool is_negative() const { return negative; }
+
+      refbig operator- () const;
+      refbig operator+ (const refbig&) const;
+      refbig operator- (const refbig&) const;
+      refbig operator* (const refbig&) const;
+      refbig operator/ (const refbig&) const;
+      refbig operator% (const refbig&) const;
+
+      bool operator== (const refbig&) const;
+      bool operator<  (const refbig&) const;
+
+      string to_radix (int radix) const;
+      friend refbig pow (const refbig& base, const refbig& exponent);
+};
+
+#endif
+
@@ -18,12 +18,17 @@ char scanner::get() {
    return currchar;
 }
 
+bool scanner::is_digit (int symbol) const {
+   if (isdigit (symbol)) return true;
+   return isupper (symbol) and symbol - 'A' + 10 < radix_;
+}
+
 token scanner::scan() {
    while (good() and isspace (nextchar)) get();
    if (not good()) return {tsymbol::SCANEOF};
-   if (nextchar == '_' or isdigit (nextchar)) {
+   if (nextchar == '_' or is_digit (nextchar)) {
       token result {tsymbol::NUMBER, {get()}};
-      while (good() and isdigit (nextchar)) result.lexinfo += get();
+      while (good() and is_digit (nextchar)) result.lexinfo += get();
       return result;
    }
    return {tsymbol::OPERATOR, {get()}};
@@ -19,15 +19,25 @@ struct token {
    }
 };
 
+// scanner -
+//    Splits input into numbers and operators.  Digits 0-9 are always
+//    part of a number, and so is an upper case letter whose digit
+//    value is less than the input radix.  So in radix 32, I and O
+//    are digits rather than operators.
+
 class scanner {
    private:
       istream& instream;
       int nextchar {instream.get()};
+      int radix_ {10};
       bool good() { return nextchar != EOF; }
+      bool is_digit (int symbol) const;
       char get();
    public:
       scanner (istream& instream_ = cin): instream(instream_) {}
       token scan();
+      int radix() const { return radix_; }
+      void radix (int new_radix) { radix_ = new_radix; }
 };
 
 ostream& operator<< (ostream&, tsymbol);
@@ -4,6 +4,7 @@
 
 #include <cctype>
 #include <algorithm>
+#include <bit>
 #include <cstdlib>
 #include <exception>
 #include <stack>
@@ -13,180 +14,419 @@ using namespace std;
 #include "ubigint.h"
 #include "debug.h"
 
-ubigint::ubigint (unsigned long that): uvalue (that) {
-   DEBUGF ('~', this << " -> " << uvalue)
+ubigint::ubigint (unsigned long that) {
+   DEBUGF ('~', this << " -> " << that)
    while (that > 0) {
-       ubig_value.push_back(that % 10);
-       that = that/10;
+      ubig_value.push_back (static_cast<udigit_t> (that));
+      that >>= LIMB_BITS;
    }
 }
+
 ubigint::ubigint (vector<udigit_t> that): ubig_value(that) {
+   trim();
+}
 
+// digit_value -
+//    Value of one digit character, or -1 if it is not a digit.
+static int digit_value (char digit) {
+   if (isdigit (digit)) return digit - '0';
+   if (isupper (digit)) return digit - 'A' + 10;
+   return -1;
 }
-ubigint::ubigint (const string& that): uvalue(0) {
-   DEBUGF ('~', "that = \"" << that << "\"");
+
+ubigint::ubigint (const string& that, int radix) {
+   DEBUGF ('~', "that = \"" << that << "\", radix = " << radix);
+   if (radix < MIN_RADIX or radix > MAX_RADIX) {
+      throw invalid_argument ("ubigint::ubigint: radix "
+                              + to_string (radix));
+   }
+   bool digits_in_radix = true;
    for (char digit: that) {
-      if (not isdigit (digit)) {
+      int value = digit_value (digit);
+      if (value < 0) {
          throw invalid_argument ("ubigint::ubigint(" + that + ")");
       }
-      uvalue = uvalue * 10 + digit - '0';
-      ubig_value.push_back(digit - '0');
+      if (value >= radix) digits_in_radix = false;
+   }
+   int bits = radix_bits (radix);
+   if (bits > 0 and digits_in_radix) {
+      // Each digit is exactly bits wide, so just pack them.
+      ubig_value.assign ((that.size() * bits + LIMB_BITS - 1)
+                         / LIMB_BITS, 0);
+      size_t bitpos = 0;
+      for (auto itor = that.crbegin(); itor != that.crend(); ++itor) {
+         udigit_t value = digit_value (*itor);
+         size_t limb = bitpos / LIMB_BITS;
+         int offset = bitpos % LIMB_BITS;
+         ubig_value[limb] |= value << offset;
+         if (offset + bits > LIMB_BITS) {
+            ubig_value[limb + 1] |= value >> (LIMB_BITS - offset);
+         }
+         bitpos += bits;
+      }
+      trim();
+      return;
+   }
+   // Otherwise consume as many digits at a time as fit in a limb.
+   size_t chunk_digits = 0;
+   udouble_t chunk_scale = 1;
+   while (chunk_scale * radix <= numeric_limits<udigit_t>::max()) {
+      chunk_scale *= radix;
+      ++chunk_digits;
+   }
+   for (size_t start = 0; start < that.size(); start += chunk_digits) {
+      size_t end = min (that.size(), start + chunk_digits);
+      udouble_t scale = 1;
+      udouble_t addend = 0;
+      for (size_t index = start; index < end; ++index) {
+         scale *= radix;
+         addend = addend * radix + digit_value (that[index]);
+      }
+      multiply_add (static_cast<udigit_t> (scale), addend);
    }
-   reverse(ubig_value.begin(), ubig_value.end());
 }
 
-ubigint ubigint::operator+ (const ubigint& that) const {
-    ubigint result(0);
-    unsigned int min_length = 0;
-    if (ubig_value.size() < that.ubig_value.size()) {
-        min_length = ubig_value.size();
-    } else {
-        min_length = that.ubig_value.size();
-    }
-    unsigned int i = 0;
-    int carry = 0;
-    int sum = 0;
-
-    for (; i < min_length; i++) {
-        sum = ubig_value.at(i) + that.ubig_value.at(i) + carry;
-        result.ubig_value.push_back(sum % 10);
-        carry = sum / 10;
-    }
-
-    if (ubig_value.size() > that.ubig_value.size()) {
-        while (i < ubig_value.size()) {
-            result.ubig_value.push_back(ubig_value.at(i));
-            i++;
-        }
-    } else {
-        while (i < that.ubig_value.size()) {
-            result.ubig_value.push_back(that.ubig_value.at(i));
-            i++;
-        }
-    }
-    if (carry) {
-        result.ubig_value.push_back(carry);
-    }
-    while (result.ubig_value.size() > 0 and result.ubig_value.back() == 0) {
-        result.ubig_value.pop_back();
-    }
-
-    return result;
+// trim -
+//    Remove high order zero limbs so that each value has exactly
+//    one representation.
+void ubigint::trim() {
+   while (ubig_value.size() > 0 and ubig_value.back() == 0) {
+      ubig_value.pop_back();
+   }
+}
+
+// multiply_add -
+//    this = this * multiplier + addend, in place.
+void ubigint::multiply_add (udigit_t multiplier, udouble_t addend) {
+   udouble_t carry = 0;
+   for (udigit_t& limb: ubig_value) {
+      udouble_t product = udouble_t (limb) * multiplier + carry;
+      limb = static_cast<udigit_t> (product);
+      carry = product >> LIMB_BITS;
+   }
+   if (carry > 0) ubig_value.push_back (static_cast<udigit_t> (carry));
+   for (size_t limb = 0; addend > 0; ++limb) {
+      if (limb == ubig_value.size()) ubig_value.push_back (0);
+      udouble_t sum = ubig_value[limb] + (addend & 0xFFFFFFFFu);
+      ubig_value[limb] = static_cast<udigit_t> (sum);
+      addend = (addend >> LIMB_BITS) + (sum >> LIMB_BITS);
+   }
+}
+
+// divide_small -
+//    this = this / divisor, in place, returning the remainder.
+ubigint::udigit_t ubigint::divide_small (udigit_t divisor) {
+   udouble_t remainder = 0;
+   for (auto itor = ubig_value.rbegin(); itor != ubig_value.rend();
+        ++itor) {
+      udouble_t dividend = (remainder << LIMB_BITS) | *itor;
+      *itor = static_cast<udigit_t> (dividend / divisor);
+      remainder = dividend % divisor;
+   }
+   trim();
+   return static_cast<udigit_t> (remainder);
+}
+
+// radix_bits -
+//    Number of bits in one digit if radix is a power of 2, else 0.
+int ubigint::radix_bits (int radix) {
+   switch (radix) {
+      case  2: return 1;
+      case  4: return 2;
+      case  8: return 3;
+      case 16: return 4;
+      case 32: return 5;
+      default: return 0;
+   }
+}
+
+string ubigint::to_radix (int radix) const {
+   static const char DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV";
+   if (radix < MIN_RADIX or radix > MAX_RADIX) {
+      throw invalid_argument ("ubigint::to_radix: radix "
+                              + to_string (radix));
+   }
+   if (ubig_value.empty()) return "0";
+   string result;
+   int bits = radix_bits (radix);
+   if (bits > 0) {
+      size_t ndigits = (bit_length() + bits - 1) / bits;
+      udigit_t mask = (1u << bits) - 1;
+      result.reserve (ndigits);
+      for (size_t digit = ndigits; digit-- > 0; ) {
+         size_t bitpos = digit * bits;
+         size_t limb = bitpos / LIMB_BITS;
+         int offset = bitpos % LIMB_BITS;
+         udigit_t value = ubig_value[limb] >> offset;
+         if (offset + bits > LIMB_BITS
+             and limb + 1 < ubig_value.size()) {
+            value |= ubig_value[limb + 1] << (LIMB_BITS - offset);
+         }
+         result += DIGITS[value & mask];
+      }
+      return result;
+   }
+   size_t chunk_digits = 0;
+   udouble_t chunk_scale = 1;
+   while (chunk_scale * radix <= numeric_limits<udigit_t>::max()) {
+      chunk_scale *= radix;
+      ++chunk_digits;
+   }
+   ubigint quotient {*this};
+   while (not quotient.ubig_value.empty()) {
+      udigit_t chunk = quotient.divide_small (
+                             static_cast<udigit_t> (chunk_scale));
+      for (size_t count = 0; count < chunk_digits; ++count) {
+         result += DIGITS[chunk % radix];
+         chunk /= radix;
+         if (quotient.ubig_value.empty() and chunk == 0) break;
+      }
+   }
+   reverse (result.begin(), result.end());
+   return result;
+}
+
+int ubigint::radix_index() {
+   static const int index = ios_base::xalloc();
+   return index;
+}
+
+int ubigint::output_radix (ios_base& stream) {
+   long radix = stream.iword (radix_index());
+   return radix == 0 ? 10 : radix;
+}
+
+void ubigint::output_radix (ios_base& stream, int radix) {
+   if (radix < MIN_RADIX or radix > MAX_RADIX) {
+      throw invalid_argument ("ubigint::output_radix: radix "
+                              + to_string (radix));
+   }
+   stream.iword (radix_index()) = radix;
+}
+
+unsigned long ubigint::to_ulong() const {
+   if (ubig_value.size() * LIMB_BITS
+       > size_t (numeric_limits<unsigned long>::digits)) {
+      throw overflow_error ("ubigint::to_ulong");
+   }
+   unsigned long result = 0;
+   for (auto itor = ubig_value.rbegin(); itor != ubig_value.rend();
+        ++itor) {
+      result = (result << LIMB_BITS) | *itor;
+   }
+   return result;
+}
 
+ubigint ubigint::operator+ (const ubigint& that) const {
+   bool this_longer = ubig_value.size() >= that.ubig_value.size();
+   const ubigvalue_t& longer = this_longer ? ubig_value
+                                           : that.ubig_value;
+   const ubigvalue_t& shorter = this_longer ? that.ubig_value
+                                            : ubig_value;
+   ubigint result;
+   result.ubig_value.reserve (longer.size() + 1);
+   udouble_t carry = 0;
+   for (size_t index = 0; index < longer.size(); ++index) {
+      udouble_t sum = carry + longer[index];
+      if (index < shorter.size()) sum += shorter[index];
+      result.ubig_value.push_back (static_cast<udigit_t> (sum));
+      carry = sum >> LIMB_BITS;
+   }
+   if (carry > 0) result.ubig_value.push_back (carry);
+   return result;
 }
 
 ubigint ubigint::operator- (const ubigint& that) const {
-    ubigint result(0);
-    unsigned int i = 0;
-    int borrow = 0;
-    int diff  = 0;
-
-    for (; i < that.ubig_value.size(); i++)  {
-        diff = ubig_value.at(i) - borrow;
-        borrow = 0;
-
-        if (diff  < that.ubig_value.at(i)) {
-            diff += 10;
-            borrow = 1;
-        }
-        result.ubig_value.push_back(diff - that.ubig_value.at(i));
-        i++;
-    }
-    while (i < ubig_value.size()) {
-        if (borrow > 0) {
-            result.ubig_value.push_back(ubig_value.at(i)-1);
-            borrow = 0;
-        } else {
-            result.ubig_value.push_back(ubig_value.at(i));
-        }
-        i++;
-    }
-
-    while (result.ubig_value.size() > 0 and result.ubig_value.back() == 0){
-        result.ubig_value.pop_back();
-    }
-    return result;
+   if (*this < that) throw domain_error ("ubigint::operator-");
+   ubigint result;
+   result.ubig_value.reserve (ubig_value.size());
+   udigit_t borrow = 0;
+   for (size_t index = 0; index < ubig_value.size(); ++index) {
+      udouble_t subtrahend = udouble_t (borrow);
+      if (index < that.ubig_value.size()) {
+         subtrahend += that.ubig_value[index];
+      }
+      udouble_t minuend = ubig_value[index];
+      borrow = minuend < subtrahend;
+      if (borrow) minuend += udouble_t (1) << LIMB_BITS;
+      result.ubig_value.push_back (
+            static_cast<udigit_t> (minuend - subtrahend));
+   }
+   result.trim();
+   return result;
 }
 
 ubigint ubigint::operator* (const ubigint& that) const {
-    vector<udigit_t> res(that.ubig_value.size() + ubig_value.size(), 0);
-    int index_n1 = 0;
-    int index_n2 = 0;
-    int carry  = 0;
-    int sum = 0;
-    for (int i = that.ubig_value.size() - 1; i >= 0; i--) {
-        carry = 0;
-        index_n2 = 0;
-        for (int j = ubig_value.size() - 1; j >= 0; j--) {
-            sum = (ubig_value.at(j) * that.ubig_value.at(i)) + res.at(index_n1 + index_n2) + carry;
-            carry = sum / 10;
-            res.at(index_n1 + index_n2) = sum % 10;
-            index_n2++;
-        }
-        if (carry > 0)
-            res.at(index_n1 + index_n2) += carry;
-        index_n1++;
-    }
-
-    int i = res.size() - 1;
-    while (i >= 0 && res.at(i) == 0) {
-        i--;
-    }
-    return ubigint(res);
+   if (ubig_value.empty() or that.ubig_value.empty()) return {};
+   ubigint result;
+   result.ubig_value.assign (ubig_value.size()
+                             + that.ubig_value.size(), 0);
+   for (size_t left = 0; left < ubig_value.size(); ++left) {
+      udouble_t carry = 0;
+      for (size_t right = 0; right < that.ubig_value.size(); ++right) {
+         udouble_t product = udouble_t (ubig_value[left])
+                           * that.ubig_value[right]
+                           + result.ubig_value[left + right] + carry;
+         result.ubig_value[left + right]
+               = static_cast<udigit_t> (product);
+         carry = product >> LIMB_BITS;
+      }
+      result.ubig_value[left + that.ubig_value.size()]
+            = static_cast<udigit_t> (carry);
+   }
+   result.trim();
+   return result;
 }
 
 void ubigint::multiply_by_2() {
-    vector<udigit_t> result;
-    int sum = 0;
-    int carry = 0;
-    for (int i = ubig_value.size() - 1; i >= 0; i--) {
-        sum = (ubig_value.at(i) * 2) + carry;
-        carry = sum / 10;
-        result.insert(result.begin(), 1, sum % 10);
-    }
-
-    if (carry > 0) {
-        result.insert(result.begin(), 1, carry);
-    }
-    ubig_value = result;
+   udigit_t carry = 0;
+   for (udigit_t& limb: ubig_value) {
+      udigit_t next_carry = limb >> (LIMB_BITS - 1);
+      limb = (limb << 1) | carry;
+      carry = next_carry;
+   }
+   if (carry > 0) ubig_value.push_back (carry);
 }
 
 void ubigint::divide_by_2() {
-    vector<udigit_t> result;
-    unsigned int i = 0;
-    int temp = ubig_value.at(i);
-    while (ubig_value.at(i) < 2) {
-        temp = temp * 10 + ubig_value.at(++i);
-    }
+   udigit_t carry = 0;
+   for (auto itor = ubig_value.rbegin(); itor != ubig_value.rend();
+        ++itor) {
+      udigit_t next_carry = *itor & 1;
+      *itor = (*itor >> 1) | (carry << (LIMB_BITS - 1));
+      carry = next_carry;
+   }
+   trim();
+}
 
-    while (ubig_value.size() > i) {
-        result.insert(result.end(), 1, temp / 2);
-        temp = (temp % 2) * 10 + ubig_value.at(++i);
-    }
-    ubig_value = result;
+// hash -
+//    FNV-1a over the limbs, used as a cheap fingerprint.
+size_t ubigint::hash() const {
+   size_t result = 14695981039346656037ul;
+   for (udigit_t digit: ubig_value) {
+      result = (result ^ digit) * 1099511628211ul;
+   }
+   return result ^ ubig_value.size();
 }
 
-
+// bytes -
+//    Approximate memory held by this number.
+size_t ubigint::bytes() const {
+   return sizeof (ubigint) + ubig_value.capacity() * sizeof (udigit_t);
+}
+
+void ubigint::set_bit (size_t bit) {
+   size_t limb = bit / LIMB_BITS;
+   if (limb >= ubig_value.size()) ubig_value.resize (limb + 1, 0);
+   ubig_value[limb] |= udigit_t (1) << (bit % LIMB_BITS);
+}
+
+size_t ubigint::popcount() const {
+   size_t count = 0;
+   for (udigit_t limb: ubig_value) count += std::popcount (limb);
+   return count;
+}
+
+size_t ubigint::bit_length() const {
+   if (ubig_value.empty()) return 0;
+   return (ubig_value.size() - 1) * LIMB_BITS
+        + bit_width (ubig_value.back());
+}
+
+ubigint ubigint::operator<< (size_t bits) const {
+   if (ubig_value.empty()) return {};
+   size_t limbs = bits / LIMB_BITS;
+   int offset = bits % LIMB_BITS;
+   ubigint result;
+   result.ubig_value.reserve (limbs + ubig_value.size() + 1);
+   result.ubig_value.assign (limbs, 0);
+   if (offset == 0) {
+      result.ubig_value.insert (result.ubig_value.end(),
+                                ubig_value.begin(), ubig_value.end());
+      return result;
+   }
+   udigit_t carry = 0;
+   for (udigit_t limb: ubig_value) {
+      result.ubig_value.push_back ((limb << offset) | carry);
+      carry = limb >> (LIMB_BITS - offset);
+   }
+   if (carry > 0) result.ubig_value.push_back (carry);
+   return result;
+}
+
+ubigint ubigint::operator>> (size_t bits) const {
+   size_t limbs = bits / LIMB_BITS;
+   if (limbs >= ubig_value.size()) return {};
+   int offset = bits % LIMB_BITS;
+   ubigint result;
+   result.ubig_value.reserve (ubig_value.size() - limbs);
+   for (size_t index = limbs; index < ubig_value.size(); ++index) {
+      udigit_t limb = ubig_value[index] >> offset;
+      if (offset > 0 and index + 1 < ubig_value.size()) {
+         limb |= ubig_value[index + 1] << (LIMB_BITS - offset);
+      }
+      result.ubig_value.push_back (limb);
+   }
+   result.trim();
+   return result;
+}
+
+ubigint ubigint::operator& (const ubigint& that) const {
+   ubigint result;
+   size_t size = min (ubig_value.size(), that.ubig_value.size());
+   result.ubig_value.reserve (size);
+   for (size_t index = 0; index < size; ++index) {
+      result.ubig_value.push_back (ubig_value[index]
+                                 & that.ubig_value[index]);
+   }
+   result.trim();
+   return result;
+}
+
+ubigint ubigint::operator| (const ubigint& that) const {
+   bool this_longer = ubig_value.size() >= that.ubig_value.size();
+   ubigint result {this_longer ? *this : that};
+   const ubigvalue_t& shorter = this_longer ? that.ubig_value
+                                            : ubig_value;
+   for (size_t index = 0; index < shorter.size(); ++index) {
+      result.ubig_value[index] |= shorter[index];
+   }
+   return result;
+}
+
+ubigint ubigint::operator^ (const ubigint& that) const {
+   bool this_longer = ubig_value.size() >= that.ubig_value.size();
+   ubigint result {this_longer ? *this : that};
+   const ubigvalue_t& shorter = this_longer ? that.ubig_value
+                                            : ubig_value;
+   for (size_t index = 0; index < shorter.size(); ++index) {
+      result.ubig_value[index] ^= shorter[index];
+   }
+   result.trim();
+   return result;
+}
+
+// udivide -
+//    Binary long division.  The divisor is shifted up once to line
+//    up with the dividend, then moved down a bit at a time, and
+//    each quotient bit is set directly.
 struct quo_rem { ubigint quotient; ubigint remainder; };
 quo_rem udivide (const ubigint& dividend, const ubigint& divisor_) {
    // NOTE: udivide is a non-member function.
-   ubigint divisor {divisor_};
    ubigint zero {0};
-   if (divisor == zero) throw domain_error ("udivide by zero");
-   ubigint power_of_2 {1};
+   if (divisor_ == zero) throw domain_error ("udivide by zero");
+   if (dividend < divisor_) return {.quotient = zero,
+                                    .remainder = dividend};
+   size_t shift = dividend.bit_length() - divisor_.bit_length();
+   ubigint divisor = divisor_ << shift;
    ubigint quotient {0};
    ubigint remainder {dividend}; // left operand, dividend
-   while (divisor < remainder) {
-      divisor.multiply_by_2();
-      power_of_2.multiply_by_2();
-   }
-   while (power_of_2 > zero) {
+   for (size_t bit = shift + 1; bit-- > 0; ) {
       if (divisor <= remainder) {
          remainder = remainder - divisor;
-         quotient = quotient + power_of_2;
+         quotient.set_bit (bit);
       }
       divisor.divide_by_2();
-      power_of_2.divide_by_2();
    }
    return {.quotient = quotient, .remainder = remainder};
 }
@@ -200,43 +440,22 @@ ubigint ubigint::operator% (const ubigint& that) const {
 }
 
 bool ubigint::operator== (const ubigint& that) const {
-    if (that.ubig_value.size() != ubig_value.size()) {
-        return false;
-    }
-    if (that.ubig_value.size() == ubig_value.size()) {
-        for (unsigned int i = 0; i < ubig_value.size(); i++) {
-            if (that.ubig_value.at(i) != ubig_value.at(i)) {
-                return false;
-            }
-        }
-    }
-    return true;
+   return ubig_value == that.ubig_value;
 }
 
 bool ubigint::operator< (const ubigint& that) const {
-    if (ubig_value.size() < that.ubig_value.size()) {
-        return true;
-    }
-    if (ubig_value.size() == that.ubig_value.size()) {
-        if (ubig_value.size() == 0) {
-            return false;
-        }
-        for (int i = ubig_value.size() - 1; i >= 0; i--) {
-            if (ubig_value.at(i) > that.ubig_value.at(i)) {
-                return false;
-            }
-        }
-        return true;
-    }
-
-    return false;
+   if (ubig_value.size() != that.ubig_value.size()) {
+      return ubig_value.size() < that.ubig_value.size();
+   }
+   for (size_t index = ubig_value.size(); index-- > 0; ) {
+      if (ubig_value[index] != that.ubig_value[index]) {
+         return ubig_value[index] < that.ubig_value[index];
+      }
+   }
+   return false;
 }
+
 ostream& operator<< (ostream& out, const ubigint& that) {
-    string output;
-    for(unsigned int i = 0;i<that.ubig_value.size();i++)
-    {
-        output.append(1, static_cast <char> (that.ubig_value.at(i) + '0'));
-    }
-    return out << output;
+   return out << that.to_radix (ubigint::output_radix (out));
 }
 
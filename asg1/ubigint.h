@@ -5,6 +5,7 @@
 #ifndef __UBIGINT_H__
 #define __UBIGINT_H__
 
+#include <cstdint>
 #include <exception>
 #include <iostream>
 #include <limits>
@@ -15,21 +16,68 @@ using namespace std;
 #include "debug.h"
 #include "relops.h"
 
+//
+// ubigint -
+//    Unsigned arbitrary precision integer, stored as a vector of
+//    32-bit limbs, least significant first, with no high zero limbs.
+//    Zero is the empty vector.
+//
+// ubigint (const string&, int radix) -
+//    Converts digits 0-9 and A-Z in the given radix.  As in dc, a
+//    digit larger than the radix is accepted and just scaled.
+//    Radices 2, 4, 8, 16, and 32 pack the digit bits straight into
+//    the limbs in linear time.
+// to_radix -
+//    Converts to a string of digits in the given radix (2 to 32).
+//    Power of two radices are unpacked from the limbs in linear
+//    time; others divide by the largest power of the radix that
+//    fits in a limb.
+// operator<< (size_t) and operator>> (size_t) -
+//    Shift by a number of bits, moving whole limbs at once, so
+//    scaling by 2^k costs time linear in the size of the value.
+// operator&, operator|, operator^ -
+//    Bitwise and, or, and exclusive or, a limb at a time.
+// popcount, bit_length -
+//    Number of one bits, and number of bits up to the highest one.
+// output_radix -
+//    The radix used by operator<< (ostream&) is kept in an iword
+//    of the stream, so each output stream has its own.  The default
+//    is 10.
+//
+
 class ubigint {
    friend ostream& operator<< (ostream&, const ubigint&);
    private:
-      using udigit_t  = unsigned char;
+      using udigit_t  = uint32_t;
+      using udouble_t = uint64_t;
       using ubigvalue_t = vector<udigit_t>;
+      static constexpr int LIMB_BITS = 32;
       ubigvalue_t ubig_value;
-      using unumber = unsigned long;
-      unumber uvalue {};
+      void trim();
+      void multiply_add (udigit_t multiplier, udouble_t addend);
+      udigit_t divide_small (udigit_t divisor);
+      static int radix_bits (int radix);
+      static int radix_index();
    public:
+      static constexpr int MIN_RADIX = 2;
+      static constexpr int MAX_RADIX = 32;
+
       void multiply_by_2();
       void divide_by_2();
+      void set_bit (size_t bit);
+      size_t popcount() const;
+      size_t bit_length() const;
+
+      size_t hash() const;
+      size_t bytes() const;
+      unsigned long to_ulong() const;
+      string to_radix (int radix) const;
+      static int output_radix (ios_base&);
+      static void output_radix (ios_base&, int radix);
 
       ubigint() = default; // Need default ctor as well.
       ubigint (unsigned long);
-      ubigint (const string&);
+      ubigint (const string&, int radix = 10);
       ubigint (vector<udigit_t>);
 
       ubigint operator+ (const ubigint&) const;
@@ -38,6 +86,12 @@ class ubigint {
       ubigint operator/ (const ubigint&) const;
       ubigint operator% (const ubigint&) const;
 
+      ubigint operator<< (size_t bits) const;
+      ubigint operator>> (size_t bits) const;
+      ubigint operator& (const ubigint&) const;
+      ubigint operator| (const ubigint&) const;
+      ubigint operator^ (const ubigint&) const;
+
       bool operator== (const ubigint&) const;
       bool operator<  (const ubigint&) const;
 };
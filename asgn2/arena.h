@@ -0,0 +1,200 @@
+// $Id: arena.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// arena -
+//    Owns every object of one type for a whole inode_state.  The
+//    objects live in chunks of slots which are never moved once
+//    allocated, so a pointer to a live object stays valid until that
+//    object is freed, and freed slots are reused through a free
+//    list.  Objects are destroyed deterministically by free or when
+//    the arena itself is destroyed, so there are no reference counts
+//    and no cycles to leak.
+//    Each chunk is twice the size of the one before, so the table of
+//    chunks has a fixed size and is never moved either.  Then one
+//    thread may free objects while another makes and uses others:
+//    make and free lock only to update the free list, and get does
+//    not lock at all.  Two threads must not use the same object.
+// make -
+//    Constructs a new object in a free slot.  The constructor is
+//    passed the object's own handle, followed by the arguments.
+// free -
+//    Destroys the object and bumps the generation of its slot, so
+//    every outstanding handle to it becomes stale.  Freeing a stale
+//    handle does nothing.
+// get -
+//    The object in a slot, or nullptr if the generation does not
+//    match.
+// for_each -
+//    Calls a function with the handle of every live object.  No
+//    other thread may be freeing objects.
+// slot_size -
+//    The bytes each slot takes:  the object, its generation and its
+//    free list link.
+//
+// handle -
+//    Names an object in an arena by slot index and generation.  It
+//    is a plain value, so copying one is free and does not touch
+//    the object.  A handle that is null or whose object has been
+//    freed compares equal to nullptr, and dereferencing it throws
+//    logic_error.  Two handles are equal if they name the same
+//    object.  For debugging, a handle prints as #index.generation.
+//
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+using namespace std;
+
+template <typename item_t> class arena;
+
+template <typename item_t>
+class handle {
+   private:
+      arena<item_t>* owner {nullptr};
+      uint32_t index {0};
+      uint32_t generation {0};
+   public:
+      handle() = default;
+      handle (nullptr_t) {}
+      handle (arena<item_t>* owner_, uint32_t index_,
+              uint32_t generation_):
+              owner (owner_), index (index_), generation (generation_) {}
+      item_t* get() const {
+         if (owner == nullptr) return nullptr;
+         return owner->get (index, generation);
+      }
+      item_t* operator->() const {
+         item_t* item = get();
+         if (item == nullptr) throw logic_error ("stale handle");
+         return item;
+      }
+      item_t& operator*() const { return *operator->(); }
+      arena<item_t>* get_arena() const { return owner; }
+      uint32_t get_index() const { return index; }
+      uint32_t get_generation() const { return generation; }
+      bool operator== (const handle& that) const {
+         return owner == that.owner and index == that.index
+            and generation == that.generation;
+      }
+      bool operator!= (const handle& that) const {
+         return not (*this == that);
+      }
+      bool operator== (nullptr_t) const { return get() == nullptr; }
+      bool operator!= (nullptr_t) const { return get() != nullptr; }
+};
+
+template <typename item_t>
+ostream& operator<< (ostream& out, const handle<item_t>& item) {
+   if (item.get_arena() == nullptr) return out << "nullptr";
+   return out << "#" << item.get_index() << "."
+              << item.get_generation();
+}
+
+template <typename item_t>
+class arena {
+   private:
+      static constexpr size_t FIRST_CHUNK = 1024;
+      static constexpr size_t MAX_CHUNKS = 23;  // over 2^32 slots
+      static constexpr uint32_t NO_SLOT = UINT32_MAX;
+      struct slot {
+         optional<item_t> item;
+         atomic<uint32_t> generation {1};
+         uint32_t next_free {NO_SLOT};
+      };
+      unique_ptr<slot[]> chunks[MAX_CHUNKS];
+      size_t chunk_count {0};
+      atomic<size_t> slots_used {0};
+      atomic<size_t> live {0};
+      atomic<size_t> freed {0};
+      uint32_t free_list {NO_SLOT};
+      mutex lock;
+      static size_t chunk_start (size_t chunk) {
+         return FIRST_CHUNK * ((size_t (1) << chunk) - 1);
+      }
+      slot& at (size_t index) const {
+         // Chunk k holds FIRST_CHUNK << k slots, starting at
+         // chunk_start (k), so k is the log of index/FIRST_CHUNK + 1.
+         unsigned long long scaled = index / FIRST_CHUNK + 1;
+         size_t chunk = 63 - __builtin_clzll (scaled);
+         return chunks[chunk][index - chunk_start (chunk)];
+      }
+   public:
+      arena() = default;
+      arena (const arena&) = delete;
+      arena& operator= (const arena&) = delete;
+
+      template <typename... args_t>
+      handle<item_t> make (args_t&&... args) {
+         uint32_t index;
+         {
+            lock_guard<mutex> guard (lock);
+            index = free_list;
+            if (index != NO_SLOT) {
+               free_list = at (index).next_free;
+            }else {
+               index = static_cast<uint32_t> (slots_used.load());
+               if (index == chunk_start (chunk_count)) {
+                  chunks[chunk_count] = make_unique<slot[]> (
+                                 FIRST_CHUNK << chunk_count);
+                  ++chunk_count;
+               }
+               ++slots_used;
+            }
+         }
+         slot& free_slot = at (index);
+         handle<item_t> self (this, index, free_slot.generation);
+         free_slot.item.emplace (self, forward<args_t> (args)...);
+         ++live;
+         return self;
+      }
+
+      void free (handle<item_t> item) {
+         if (item.get_arena() != this or item == nullptr) return;
+         slot& used_slot = at (item.get_index());
+         ++used_slot.generation;
+         used_slot.item.reset();
+         {
+            lock_guard<mutex> guard (lock);
+            used_slot.next_free = free_list;
+            free_list = item.get_index();
+         }
+         --live;
+         ++freed;
+      }
+
+      item_t* get (uint32_t index, uint32_t generation) const {
+         if (index >= slots_used) return nullptr;
+         slot& item_slot = at (index);
+         if (item_slot.generation != generation) return nullptr;
+         return &*item_slot.item;
+      }
+
+      template <typename function_t>
+      void for_each (function_t function) {
+         for (size_t index = 0; index < slots_used; ++index) {
+            slot& item_slot = at (index);
+            if (not item_slot.item) continue;
+            uint32_t slot_index = static_cast<uint32_t> (index);
+            function (handle<item_t> (this, slot_index,
+                                      item_slot.generation));
+         }
+      }
+
+      size_t size() const { return live; }
+      size_t capacity() const { return chunk_start (chunk_count); }
+      size_t freed_count() const { return freed; }
+      static constexpr size_t slot_size() { return sizeof (slot); }
+};
+
+#endif
+
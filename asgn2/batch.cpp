@@ -0,0 +1,130 @@
+// $Id: batch.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstring>
+using namespace std;
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "debug.h"
+#include "file_sys.h"
+
+script_reader::script_reader (const string& filename) {
+   if (filename == "-") {
+      fd = STDIN_FILENO;
+      return;
+   }
+   int file = open (filename.c_str(), O_RDONLY);
+   if (file < 0) throw file_error (filename + ": " + strerror (errno));
+   struct stat status;
+   if (fstat (file, &status) < 0) {
+      int error = errno;
+      close (file);
+      throw file_error (filename + ": " + strerror (error));
+   }
+   length = status.st_size;
+   if (length > 0) {
+      void* base = mmap (nullptr, length, PROT_READ, MAP_PRIVATE,
+                         file, 0);
+      if (base == MAP_FAILED) {
+         int error = errno;
+         close (file);
+         throw file_error (filename + ": " + strerror (error));
+      }
+      mapped = static_cast<const char*> (base);
+      madvise (base, length, MADV_SEQUENTIAL);
+   }
+   close (file);
+   at_eof = true;
+}
+
+script_reader::~script_reader() {
+   if (mapped != nullptr) {
+      munmap (const_cast<char*> (mapped), length);
+   }
+}
+
+// fill -
+//    Reads another block of stdin after what is left of the last.
+//    Returns false at end of file.
+bool script_reader::fill() {
+   if (at_eof) return false;
+   block.erase (0, position);
+   position = 0;
+   size_t used = block.size();
+   block.resize (used + BLOCK_SIZE);
+   ssize_t count;
+   do {
+      count = read (fd, block.data() + used, BLOCK_SIZE);
+   } while (count < 0 and errno == EINTR);
+   block.resize (used + (count > 0 ? count : 0));
+   if (count <= 0) at_eof = true;
+   mapped = block.data();
+   length = block.size();
+   return count > 0;
+}
+
+bool script_reader::getline (string& line) {
+   for (;;) {
+      const void* newline = mapped == nullptr ? nullptr
+                          : memchr (mapped + position, '\n',
+                                    length - position);
+      if (newline != nullptr) {
+         const char* end = static_cast<const char*> (newline);
+         line.assign (mapped + position, end);
+         position = end - mapped + 1;
+         return true;
+      }
+      if (not fill()) break;
+   }
+   if (position >= length) return false;
+   line.assign (mapped + position, mapped + length);
+   position = length;
+   return true;
+}
+
+batch_output::batch_output (int fd_): fd (fd_), buffer (BUFFER_SIZE) {
+   setp (buffer.data(), buffer.data() + buffer.size());
+}
+
+batch_output::~batch_output() {
+   flush();
+}
+
+bool batch_output::write_buffer() {
+   const char* data = pbase();
+   size_t size = pptr() - pbase();
+   setp (buffer.data(), buffer.data() + buffer.size());
+   while (size > 0) {
+      ssize_t count = write (fd, data, size);
+      if (count < 0 and errno == EINTR) continue;
+      if (count < 0) return false;
+      data += count;
+      size -= count;
+   }
+   return true;
+}
+
+streambuf::int_type batch_output::overflow (int_type byte) {
+   if (not write_buffer()) return traits_type::eof();
+   if (traits_type::eq_int_type (byte, traits_type::eof())) {
+      return traits_type::not_eof (byte);
+   }
+   *pptr() = traits_type::to_char_type (byte);
+   pbump (1);
+   return byte;
+}
+
+int batch_output::sync() {
+   return 0;
+}
+
+bool batch_output::flush() {
+   DEBUGF ('b', "flush " << pptr() - pbase() << " bytes");
+   return write_buffer();
+}
+
@@ -0,0 +1,72 @@
+// $Id: batch.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// Batch mode -
+//    Replays a script without the overhead of an interactive
+//    session:  no prompt, no echo, and no flush after each line.
+//
+// script_reader -
+//    Reads lines from a script file, which is mapped with mmap, or
+//    from stdin if the name is "-", which is read in large blocks.
+//    Lines are returned without their newline.  A last line without
+//    a newline is still returned.
+// ctor -
+//    Throws file_error if the file can not be opened or mapped.
+//
+// batch_output -
+//    A stream buffer for cout which collects output in one large
+//    buffer and writes it to a file descriptor only when the buffer
+//    is full or flush is called.  Flushing the stream, as endl does,
+//    does nothing, so commands need not be changed.
+// flush -
+//    Writes the buffer.  Called at the end of the script, before
+//    each error message, since errors go to cerr unbuffered, and by
+//    the flush command, to see the output so far.
+//
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+class script_reader {
+   private:
+      static constexpr size_t BLOCK_SIZE = 1 << 20;
+      const char* mapped {nullptr};
+      size_t length {0};
+      size_t position {0};
+      int fd {-1};
+      string block;
+      bool at_eof {false};
+      bool fill();
+   public:
+      explicit script_reader (const string& filename);
+      ~script_reader();
+      script_reader (const script_reader&) = delete;
+      script_reader& operator= (const script_reader&) = delete;
+      bool getline (string& line);
+};
+
+class batch_output: public streambuf {
+   private:
+      static constexpr size_t BUFFER_SIZE = 1 << 20;
+      int fd;
+      vector<char> buffer;
+      bool write_buffer();
+   protected:
+      virtual int_type overflow (int_type byte) override;
+      virtual int sync() override;
+   public:
+      explicit batch_output (int fd_);
+      ~batch_output();
+      batch_output (const batch_output&) = delete;
+      batch_output& operator= (const batch_output&) = delete;
+      bool flush();
+};
+
+#endif
+
@@ -0,0 +1,159 @@
+// $Id: blobs.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <atomic>
+#include <cstdint>
+using namespace std;
+
+#include "blobs.h"
+#include "debug.h"
+
+mutex blob_store::lock;
+unordered_multimap<size_t,blob_store::entry> blob_store::table;
+
+// join_hash -
+//    FNV-1a of the words joined by single spaces, and the length of
+//    the joined text.
+static size_t join_hash (word_range words, size_t& length) {
+   uint64_t hash = 14695981039346656037u;
+   auto add = [&hash] (unsigned char byte) {
+      hash ^= byte;
+      hash *= 1099511628211u;
+   };
+   length = 0;
+   for (auto itor = words.first; itor != words.second; ++itor) {
+      if (itor != words.first) {
+         add (' ');
+         ++length;
+      }
+      for (unsigned char byte: *itor) add (byte);
+      length += itor->size();
+   }
+   return static_cast<size_t> (hash);
+}
+
+// same_text -
+//    True if a blob holds exactly the words joined.
+static bool same_text (const blob& each, word_range words,
+                       size_t length) {
+   if (each.text.size() != length) return false;
+   size_t count = words.second - words.first;
+   if (each.word_starts.size() != count) return false;
+   for (size_t index = 0; index < count; ++index) {
+      const string& word = words.first[index];
+      if (each.text.compare (each.word_starts[index], word.size(),
+                             word) != 0) return false;
+   }
+   return true;
+}
+
+blob_ptr blob_store::intern (word_range words) {
+   size_t length;
+   size_t hash = join_hash (words, length);
+   // Letting go of the last reference to a blob locks the table, so
+   // those looked at are let go of after the guard unlocks it.
+   vector<blob_ptr> held;
+   lock_guard<mutex> guard (lock);
+   auto [first, last] = table.equal_range (hash);
+   for (auto itor = first; itor != last; ++itor) {
+      // One whose last file is letting go of it is not shared.
+      held.push_back (itor->second.shared.lock());
+      if (held.back() != nullptr
+          and same_text (*held.back(), words, length)) {
+         return held.back();
+      }
+   }
+   blob* made = new blob;
+   made->hash = hash;
+   made->interned = true;
+   made->text.reserve (length);
+   made->word_starts.reserve (words.second - words.first);
+   for (auto itor = words.first; itor != words.second; ++itor) {
+      if (itor != words.first) made->text += ' ';
+      made->word_starts.push_back (made->text.size());
+      made->text += *itor;
+   }
+   blob_ptr shared (made, release);
+   table.emplace (hash, entry {made, shared});
+   return shared;
+}
+
+void blob_store::append (blob_ptr& contents, string_view text,
+                         const vector<size_t>& starts,
+                         word_range words) {
+   blob* growing = nullptr;
+   if (contents != nullptr and contents.use_count() == 1) {
+      // Pairs with the release of any other reference, which may
+      // have been let go of on the reclaimer's thread.
+      atomic_thread_fence (memory_order_acquire);
+      if (not contents->interned) {
+         growing = const_cast<blob*> (contents.get());
+      }else {
+         // Once out of the table, intern cannot share it.
+         lock_guard<mutex> guard (lock);
+         if (contents.use_count() == 1) {
+            take (contents.get());
+            growing = const_cast<blob*> (contents.get());
+            growing->interned = false;
+         }
+      }
+   }
+   if (growing == nullptr) {
+      growing = new blob;
+      growing->hash = 0;
+      growing->interned = false;
+      growing->text = text;
+      growing->word_starts = starts;
+      contents = blob_ptr (growing, release);
+   }
+   for (auto itor = words.first; itor != words.second; ++itor) {
+      if (not growing->word_starts.empty()) growing->text += ' ';
+      growing->word_starts.push_back (growing->text.size());
+      growing->text += *itor;
+   }
+}
+
+// take -
+//    Removes a blob from the table.  The caller holds the lock.
+void blob_store::take (const blob* gone) {
+   auto [first, last] = table.equal_range (gone->hash);
+   for (auto itor = first; itor != last; ++itor) {
+      if (itor->second.raw == gone) {
+         table.erase (itor);
+         break;
+      }
+   }
+}
+
+void blob_store::release (const blob* gone) {
+   if (gone->interned) {
+      lock_guard<mutex> guard (lock);
+      take (gone);
+   }
+   delete gone;
+}
+
+void blob_store::print_stats (ostream& out) {
+   lock_guard<mutex> guard (lock);
+   size_t blobs = 0;
+   size_t references = 0;
+   size_t stored = 0;
+   size_t unshared = 0;
+   for (const auto& [hash, each]: table) {
+      long count = each.shared.use_count();
+      if (count == 0) continue;
+      size_t bytes = sizeof (blob) + each.raw->text.capacity()
+                   + each.raw->word_starts.capacity() * sizeof (size_t);
+      ++blobs;
+      references += count;
+      stored += bytes;
+      unshared += bytes * count;
+   }
+   out << "blobs: " << blobs << " distinct, " << references
+       << " references, " << stored << " bytes stored, " << unshared
+       << " unshared";
+   if (stored > 0) {
+      out << ", dedup ratio " << static_cast<double> (unshared) / stored;
+   }
+   out << endl;
+}
+
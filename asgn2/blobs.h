@@ -0,0 +1,76 @@
+// $Id: blobs.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// blob -
+//    The text of a plain file, its words separated by single spaces
+//    as cat prints them, with the offset of the start of each word.
+//    Never changed once made, so every file with the same text, in
+//    the live tree or in a snapshot, shares one, except one being
+//    appended to, which is no longer interned.
+//
+// blob_store -
+//    Content addressed storage for the texts of files.
+// intern -
+//    Returns the blob holding the words as they would be joined.
+//    The words are hashed as they would be joined without joining
+//    them, so when an equal blob exists, which is then returned,
+//    nothing is allocated.  Otherwise a new blob is made and kept
+//    in the table.  A blob leaves the table when the last file using
+//    it lets go of it, which may be on the reclaimer's thread, so
+//    the table is locked.
+// append -
+//    Adds words to the end of a file's blob.  A blob only that file
+//    uses is taken out of the table and extended in place, so that
+//    appending costs amortized O(1) per byte.  Any other is copied
+//    first, from the text and word offsets given, since a file
+//    mapped from an image has no blob.  A blob taken out of the
+//    table is not shared again until the file is rewritten.
+// print_stats -
+//    The number of distinct blobs and of references to them, and
+//    the bytes the texts would take if each file had its own copy,
+//    over the bytes they take, which is the dedup ratio.  Blobs not
+//    in the table are not counted.
+//
+
+#ifndef __BLOBS_H__
+#define __BLOBS_H__
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "util.h"
+
+struct blob {
+   string text;
+   vector<size_t> word_starts;
+   size_t hash;
+   bool interned;
+};
+using blob_ptr = shared_ptr<const blob>;
+
+class blob_store {
+   private:
+      struct entry {
+         const blob* raw;
+         weak_ptr<const blob> shared;
+      };
+      static mutex lock;
+      static unordered_multimap<size_t,entry> table;
+      static void take (const blob* gone);
+      static void release (const blob* gone);
+   public:
+      static blob_ptr intern (word_range words);
+      static void append (blob_ptr& contents, string_view text,
+                          const vector<size_t>& starts,
+                          word_range words);
+      static void print_stats (ostream& out);
+};
+
+#endif
+
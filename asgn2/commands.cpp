@@ -2,27 +2,47 @@
 //By: Zhuoxuan Wang (zwang437@ucsc.edu)
 //and Xiong Lou (xlou2@ucsc.edu)
 
+#include "batch.h"
 #include "commands.h"
 #include "debug.h"
+#include <cstdio>
 #include <string>
 #include <iostream>
+#include <set>
+#include <shared_mutex>
 #include <sstream>
+#include <unordered_set>
 
 command_hash cmd_hash {
+   {"append", fn_append},
    {"cat"   , fn_cat   },
    {"cd"    , fn_cd    },
+   {"cp"    , fn_cp    },
+   {"diff"  , fn_diff  },
+   {"du"    , fn_du    },
    {"echo"  , fn_echo  },
    {"exit"  , fn_exit  },
+   {"flush" , fn_flush },
+   {"grep"  , fn_grep  },
+   {"load"  , fn_load  },
    {"ls"    , fn_ls    },
    {"lsr"   , fn_lsr   },
    {"make"  , fn_make  },
+   {"meminfo", fn_meminfo},
    {"mkdir" , fn_mkdir },
+   {"mv"    , fn_mv    },
    {"prompt", fn_prompt},
    {"pwd"   , fn_pwd   },
+   {"restore", fn_restore},
    {"rm"    , fn_rm    },
    {"rmr"    , fn_rmr    },
+   {"save"  , fn_save  },
+   {"snapshot", fn_snapshot},
+   {"stat"  , fn_stat  },
 };
 
+command_stats call_stats {cmd_hash};
+
 command_fn find_command_fn (const string& cmd) {
    // Note: value_type is pair<const key_type, mapped_type>
    // So: iterator->first is key_type (string)
@@ -35,6 +55,65 @@ command_fn find_command_fn (const string& cmd) {
    return result->second;
 }
 
+// Commands that change the tree, which hold its lock exclusively,
+// and grep, which rebuilds and prunes the word index, and meminfo,
+// which walks every inode.  The rest only read it, and share the
+// lock.
+const unordered_set<string> tree_writers {
+   "append", "cp", "grep", "load", "make", "meminfo", "mkdir", "mv",
+   "restore", "rm", "rmr", "snapshot",
+};
+
+void run_command (inode_state& state, const wordvec& words) {
+   command_fn fn = find_command_fn (words.at(0));
+   command_stats::timer timing (call_stats, words[0]);
+   shared_mutex& lock = state.get_tree()->lock;
+   try {
+      if (tree_writers.count (words[0]) > 0) {
+         unique_lock<shared_mutex> writing (lock);
+         state.refresh();
+         fn (state, words);
+      }else {
+         shared_lock<shared_mutex> reading (lock);
+         state.refresh();
+         fn (state, words);
+      }
+   }catch (ysh_exit&) {
+      timing.succeeded();
+      throw;
+   }
+   timing.succeeded();
+}
+
+wordvec run_line (inode_state& state, const wordvec& words) {
+   if (not state.here_end.empty()) {
+      if (words.size() == 1 and words[0] == state.here_end) {
+         state.here_end.clear();
+         state.here_path.clear();
+         return {};
+      }
+      // The make that opened it failed.
+      if (state.here_path.empty()) return {};
+      wordvec append {"append", state.here_path};
+      append.insert (append.end(), words.cbegin(), words.cend());
+      run_command (state, append);
+      return append;
+   }
+   if (words.empty() or words[0][0] == '#') return {};
+   const string& last = words.back();
+   if (words[0] == "make" and words.size() > 2 and last.size() > 2
+       and last.compare (0, 2, "<<") == 0) {
+      wordvec make (words.cbegin(), words.cend() - 1);
+      state.here_end = last.substr (2);
+      run_command (state, make);
+      // Absolute, in case the cwd is moved while it is open.
+      state.here_path = state.full_path (make[1]);
+      return make;
+   }
+   run_command (state, words);
+   return words;
+}
+
 command_error::command_error (const string& what):
             runtime_error (what) {
 }
@@ -45,23 +124,61 @@ int exit_status_message() {
    return status;
 }
 
-void fn_cat (inode_state& state, const wordvec& words){
+void fn_append (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   if(words.size() > 1) {
-       inode_ptr node= state.get_inode_from_path(words[1], false);
-       if(node != nullptr && node->f_type == file_type::PLAIN_TYPE) {
-           const wordvec &data = node->get_file()->readfile();
-           cout << word_range (data.cbegin(), data.cend()) << endl;
+   if (words.size() > 1) {
+       inode_ptr node = state.get_writable_inode(words[1], true);
+       if (node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
+           word_range data (words.cbegin() + 2, words.cend());
+           inode_ptr old = state.get_inode_from_path(words[1], false);
+           if (old == nullptr) {
+               const string name {state.get_name_from_path(words[1])};
+               inode_ptr file = node->get_dir()->mkfile(name, data);
+               state.index_file(file, words[1]);
+               state.update_totals(words[1], {}, state.totals_of(file));
+               state.forget_path(words[1], false);
+               return;
+           }
+           if (old->f_type != file_type::PLAIN_TYPE) {
+               throw command_error (words[0] + ": " + words[1]
+                                    + ": is a directory");
+           }
+           subtree_totals before = state.totals_of(old);
+           inode_ptr file = state.get_writable_inode(words[1], false);
+           file->get_file()->appendfile(data);
+           if (file != old) {
+               // Copied from a snapshot's, which is what is indexed.
+               state.unindex_file(old);
+               state.index_file(file, words[1]);
+           } else {
+               state.index_appended(file, data);
+           }
+           state.update_totals(words[1], before, state.totals_of(file));
            return;
        }
    }
-   string err_msg = words[0] + ": ";
-   if(words.size() > 1) {
-       err_msg += words[1] + ": ";
+    string err_msg = words[0] + ": ";
+    if(words.size() > 1) {
+        err_msg += words[1] + ": ";
+    }
+    err_msg += "No such dictionary.";
+    throw command_error (err_msg);
+}
+
+void fn_cat (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2) {
+       throw command_error (words[0] + ": No such file.");
+   }
+   for(const string& path : state.glob(words[1])) {
+       inode_ptr node= state.get_inode_from_path(path, false);
+       if(node == nullptr || node->f_type != file_type::PLAIN_TYPE) {
+           throw command_error (words[0] + ": " + path + ": No such file.");
+       }
+       cout << node->get_file()->readfile() << endl;
    }
-   err_msg += "No such file.";
-   throw command_error (err_msg);
 }
 
 void fn_cd (inode_state& state, const wordvec& words){
@@ -70,6 +187,7 @@ void fn_cd (inode_state& state, const wordvec& words){
     if(words.size() > 1) {
        inode_ptr node= state.get_inode_from_path(words[1], false);
        if(node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
+           state.update_pwd(words[1]);
            state.cwd = node;
            return;
        } else {
@@ -81,11 +199,107 @@ void fn_cd (inode_state& state, const wordvec& words){
           throw command_error (err_msg);
        }
     } else {
-        state.cwd = state.root;
+        state.update_pwd("/");
+        state.cwd = state.get_root();
     }
 
 }
 
+// copy_or_move -
+//    Copies or moves each path matching the sources to the last
+//    word, which must be a directory if there is more than one.
+//    Options start with a dash, and come before the paths.  If one
+//    fails after others were done, the error records the command
+//    for those that were done, for the journal.
+static void copy_or_move (inode_state& state, const wordvec& words,
+                          const string& options) {
+   auto first = words.cbegin() + 1;
+   bool recursive = false;
+   while(first != words.cend() && (*first)[0] == '-') {
+       if(first->size() < 2 || first->find_first_not_of(options, 1)
+                               != string::npos) {
+           throw command_error (words[0] + ": " + *first
+                                + ": invalid option");
+       }
+       recursive = true;
+       ++first;
+   }
+   if(words.cend() - first < 2) {
+       throw command_error (words[0] + ": usage: " + words[0]
+                            + (options.empty() ? "" : " [-" + options + "]")
+                            + " source... target");
+   }
+   const string& target = words.back();
+   wordvec sources;
+   for(auto word = first; word != words.cend() - 1; ++word) {
+       wordvec matches = state.glob(*word);
+       sources.insert(sources.end(), matches.begin(), matches.end());
+   }
+   if(sources.size() > 1) {
+       inode_ptr node = state.get_inode_from_path(target, false);
+       if(node == nullptr || node->f_type != file_type::DIRECTORY_TYPE) {
+           throw command_error (words[0] + ": " + target
+                                + ": No such directory");
+       }
+   }
+   wordvec applied (words.cbegin(), first);
+   size_t options_end = applied.size();
+   for(const string& source : sources) {
+       try {
+           if(options.empty()) {
+               state.move_path(source, target);
+           } else {
+               state.copy_path(source, target, recursive);
+           }
+       } catch(command_error& error) {
+           if(applied.size() > options_end) {
+               applied.push_back(target);
+               error.applied = move(applied);
+           }
+           throw;
+       }
+       applied.push_back(source);
+   }
+}
+
+void fn_cp (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   copy_or_move(state, words, "r");
+}
+
+void fn_diff (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2) {
+       throw command_error (words[0] + ": snapshot name required");
+   }
+   state.diff_snapshot(words[1], words.size() > 2 ? words[2] : "", cout);
+}
+
+void fn_du (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   wordvec paths;
+   for (auto word = words.cbegin() + 1; word != words.cend(); ++word) {
+       wordvec matches = state.glob(*word);
+       paths.insert(paths.end(), matches.begin(), matches.end());
+   }
+   if (paths.empty()) paths.push_back (state.pwd);
+   for (const string& path: paths) {
+       inode_ptr node = state.get_inode_from_path(path, false);
+       if (node == nullptr) {
+           throw command_error (words[0] + ": " + path
+                                + ": No such file or directory");
+       }
+       subtree_totals totals = state.totals_of(node);
+       char numbers[64];
+       snprintf(numbers, sizeof numbers, "%8zu %6zu %6zu  ",
+                totals.bytes, totals.files, totals.directories);
+       cout << numbers << state.full_path(path) << endl;
+   }
+}
+
 void fn_echo (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
@@ -102,23 +316,84 @@ void fn_exit (inode_state& state, const wordvec& words){
    throw ysh_exit();
 }
 
+void fn_flush (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   // Only a batch buffer holds output back.
+   batch_output* batch = dynamic_cast<batch_output*> (cout.rdbuf());
+   if(batch == nullptr) {
+       cout.flush();
+   } else if(!batch->flush()) {
+       throw command_error (words[0] + ": write failed");
+   }
+}
+
+// drop_nested -
+//    Drops each path that is below another one, so a recursive
+//    command visits everything once.
+static void drop_nested (wordvec& paths) {
+   set<string_view> all (paths.begin(), paths.end());
+   if(all.count("/")) {
+       paths = {"/"};
+       return;
+   }
+   wordvec outer;
+   for(string& path : paths) {
+       bool nested = false;
+       for(size_t slash = path.find('/', 1); slash != string::npos;
+           slash = path.find('/', slash + 1)) {
+           if(all.count(string_view(path).substr(0, slash))) {
+               nested = true;
+               break;
+           }
+       }
+       if(!nested) outer.push_back(path);
+   }
+   paths = move(outer);
+}
+
+void fn_grep (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2 || words.size() > 3) {
+       throw command_error (words[0] + ": usage: grep word [path]");
+   }
+   if(words.size() == 2) {
+       state.grep(words[1], state.pwd, cout);
+       return;
+   }
+   wordvec paths = state.glob(words[2]);
+   drop_nested(paths);
+   for(const string& path : paths) {
+       state.grep(words[1], path, cout);
+   }
+}
+
+void fn_load (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2) {
+       throw command_error (words[0] + ": file name required");
+   }
+   state.load_image(words[1]);
+}
+
 void fn_ls (inode_state& state, const wordvec& words){
     DEBUGF ('c', state);
     DEBUGF ('c', words);
     if (words.size() == 1) {
-       state.get_cur_dir()->ls(false);
+       state.get_cur_dir()->ls(cout, state.pwd,
+                               state.get_inode_from_path("..", false), false);
     } else {
-       inode_ptr node = state.get_inode_from_path(words[1], false);
-       if (node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
-           node->get_dir()->ls(false);
-           return;
+       for (const string& path : state.glob(words[1])) {
+           inode_ptr node = state.get_inode_from_path(path, false);
+           if (node == nullptr || node->f_type != file_type::DIRECTORY_TYPE) {
+               throw command_error (words[0] + ": " + path
+                                    + ": No such dictionary.");
+           }
+           inode_ptr parent = state.get_inode_from_path(path + "/..", false);
+           node->get_dir()->ls(cout, state.full_path(path), parent, false);
        }
-        string err_msg = words[0] + ": ";
-        if(words.size() > 1) {
-            err_msg += words[1] + ": ";
-        }
-        err_msg += "No such dictionary.";
-        throw command_error (err_msg);
     }
 }
 
@@ -128,10 +403,12 @@ void fn_lsr (inode_state& state, const wordvec& words){
    directory_ptr cur_dir;
    if (words.size() == 1) {
        cur_dir = state.get_cur_dir();
-       cur_dir->ls(true);
+       cur_dir->ls(cout, state.pwd, state.get_inode_from_path("..", false),
+                   true);
    } else {
        for(size_t i = 1; i < words.size(); i++) {
-           inode_ptr node = state.get_inode_from_path(words[i], false);
+         for(const string& path : state.glob(words[i])) {
+           inode_ptr node = state.get_inode_from_path(path, false);
            if (node == nullptr || node->f_type != file_type::DIRECTORY_TYPE) {
                string err_msg = words[0] + ": ";
                if (words.size() > 1) {
@@ -141,7 +418,9 @@ void fn_lsr (inode_state& state, const wordvec& words){
                throw command_error(err_msg);
            }
            cur_dir = node->get_dir();
-           cur_dir->ls(true);
+           cur_dir->ls(cout, state.full_path(path),
+                       state.get_inode_from_path(path + "/..", false), true);
+         }
        }
    }
 
@@ -152,12 +431,17 @@ void fn_make (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if (words.size() > 1) {
-       inode_ptr node = state.get_inode_from_path(words[1], true);
+       inode_ptr node = state.get_writable_inode(words[1], true);
        if (node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
-           const string name = state.get_name_from_path(words[1]);
-           wordvec data;
-           copy(words.begin() + 2, words.end(), back_inserter(data));
-           node->get_dir()->mkfile(name, data);
+           const string name {state.get_name_from_path(words[1])};
+           word_range data (words.cbegin() + 2, words.cend());
+           inode_ptr old = state.get_inode_from_path(words[1], false);
+           if (old != nullptr) state.unindex_file(old);
+           subtree_totals before = state.totals_of(old);
+           inode_ptr file = node->get_dir()->mkfile(name, data);
+           state.index_file(file, words[1]);
+           state.update_totals(words[1], before, state.totals_of(file));
+           state.forget_path(words[1], false);
            return;
        }
    }
@@ -169,14 +453,25 @@ void fn_make (inode_state& state, const wordvec& words){
     throw command_error (err_msg);
 }
 
+void fn_meminfo (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   state.print_memory(cout);
+   state.print_inode_stats(cout);
+   state.print_dentry_stats(cout);
+   print_malloc_stats(cout);
+}
+
 void fn_mkdir (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if (words.size() > 1) {
-       inode_ptr node = state.get_inode_from_path(words[1], true);
+       inode_ptr node = state.get_writable_inode(words[1], true);
        if (node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
-           const string name = state.get_name_from_path(words[1]);
-           node->get_dir()->mkdir(name);
+           const string name {state.get_name_from_path(words[1])};
+           inode_ptr dir = node->get_dir()->mkdir(name);
+           state.update_totals(words[1], {}, state.totals_of(dir));
+           state.forget_path(words[1], false);
            return;
        }
    }
@@ -188,6 +483,12 @@ void fn_mkdir (inode_state& state, const wordvec& words){
     throw command_error (err_msg);
 }
 
+void fn_mv (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   copy_or_move(state, words, "");
+}
+
 void fn_prompt (inode_state& state, const wordvec& words){
    std::stringstream buffer;
    buffer << word_range (words.cbegin() + 1, words.cend());
@@ -197,46 +498,94 @@ void fn_prompt (inode_state& state, const wordvec& words){
 }
 
 void fn_pwd (inode_state& state, const wordvec& words){
-   cout << state.cwd->path << endl;
+   cout << state.pwd << endl;
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
 
-void fn_rm (inode_state& state, const wordvec& words){
+void fn_restore (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   if(words.size() > 1) {
-       inode_ptr node= state.get_inode_from_path(words[1], true);
-       if(node != nullptr) {
-           const string name = state.get_name_from_path(words[1]);
-           node->get_dir()->remove(name, false);
-           return;
+   if(words.size() < 2) {
+       throw command_error (words[0] + ": snapshot name required");
+   }
+   state.restore_snapshot(words[1]);
+}
+
+// remove_paths -
+//    Removes every path matching words[1].  Everything is checked
+//    before anything is removed, so a failure changes nothing.
+static void remove_paths (inode_state& state, const wordvec& words,
+                          bool recursive) {
+   string err_msg = words[0] + ": ";
+   if(words.size() < 2) {
+       throw command_error (err_msg + "No such file or dictionary");
+   }
+   wordvec paths;
+   for(const string& path : state.glob(words[1])) {
+       inode_ptr node = state.get_inode_from_path(path, true);
+       if(node == nullptr) {
+           throw command_error (err_msg + path + ": No such file or dictionary");
+       }
+       string_view name = state.get_name_from_path(path);
+       if(name.empty() || name == "." || name == "..") continue;
+       inode_ptr entry = state.get_inode_from_path(path, false);
+       if(entry == nullptr) {
+           throw command_error ("No such file or directory.");
+       }
+       if(!recursive && entry->f_type == file_type::DIRECTORY_TYPE
+          && entry->size() > 2) {
+           throw command_error ("directory not empty");
        }
+       paths.push_back(path);
    }
-    string err_msg = words[0] + ": ";
-    if(words.size() > 1) {
-        err_msg += words[1] + ": ";
-    }
-    err_msg += "No such file or dictionary";
-    throw command_error (err_msg);
+   // Anything below a directory already being removed goes with it.
+   drop_nested(paths);
+   if(paths.empty()) return;
+   for(const string& path : paths) {
+       inode_ptr node= state.get_writable_inode(path, true);
+       string_view name = state.get_name_from_path(path);
+       inode_ptr removed = node->get_dir()->remove(name, recursive);
+       state.update_totals(path, state.totals_of(removed), {});
+       state.forget_path(path,
+                         removed->f_type == file_type::DIRECTORY_TYPE);
+       state.reclaim(removed);
+   }
+}
+
+void fn_rm (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   remove_paths(state, words, false);
 }
 
 void fn_rmr (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   if(words.size() > 1) {
-       inode_ptr node= state.get_inode_from_path(words[1], true);
-       if(node != nullptr) {
-           const string name = state.get_name_from_path(words[1]);
-           node->get_dir()->remove(name, true);
-           return;
-       }
+   remove_paths(state, words, true);
+}
+
+void fn_save (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2) {
+       throw command_error (words[0] + ": file name required");
    }
-   string err_msg = words[0] + ": ";
-   if(words.size() > 1) {
-       err_msg += words[1] + ": ";
+   state.save_image(words[1]);
+}
+
+void fn_snapshot (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() < 2) {
+       state.list_snapshots(cout);
+   } else {
+       state.take_snapshot(words[1]);
    }
-   err_msg += "No such file or dictionary";
-   throw command_error (err_msg);
 }
 
+void fn_stat (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   call_stats.print(cout);
+}
@@ -7,6 +7,7 @@
 using namespace std;
 
 #include "file_sys.h"
+#include "stats.h"
 #include "util.h"
 
 // A couple of convenient usings to avoid verbosity.
@@ -17,28 +18,73 @@ using command_hash = unordered_map<string,command_fn>;
 // command_error -
 //    Extend runtime_error for throwing exceptions related to this 
 //    program.
+// applied -
+//    If a command with several operands fails after some of them
+//    changed the tree, the words of a command that makes just those
+//    changes, which the journal logs in place of the failed one.
+//    Otherwise empty.
 
 class command_error: public runtime_error {
    public: 
+      wordvec applied;
       explicit command_error (const string& what);
 };
 
 // execution functions -
 
+void fn_append (inode_state& state, const wordvec& words);
 void fn_cat    (inode_state& state, const wordvec& words);
 void fn_cd     (inode_state& state, const wordvec& words);
+void fn_cp     (inode_state& state, const wordvec& words);
+void fn_diff   (inode_state& state, const wordvec& words);
+void fn_du     (inode_state& state, const wordvec& words);
 void fn_echo   (inode_state& state, const wordvec& words);
 void fn_exit   (inode_state& state, const wordvec& words);
+void fn_flush  (inode_state& state, const wordvec& words);
+void fn_grep   (inode_state& state, const wordvec& words);
+void fn_load   (inode_state& state, const wordvec& words);
 void fn_ls     (inode_state& state, const wordvec& words);
 void fn_lsr    (inode_state& state, const wordvec& words);
 void fn_make   (inode_state& state, const wordvec& words);
+void fn_meminfo (inode_state& state, const wordvec& words);
 void fn_mkdir  (inode_state& state, const wordvec& words);
+void fn_mv     (inode_state& state, const wordvec& words);
 void fn_prompt (inode_state& state, const wordvec& words);
 void fn_pwd    (inode_state& state, const wordvec& words);
+void fn_restore (inode_state& state, const wordvec& words);
 void fn_rm     (inode_state& state, const wordvec& words);
 void fn_rmr    (inode_state& state, const wordvec& words);
+void fn_save   (inode_state& state, const wordvec& words);
+void fn_snapshot (inode_state& state, const wordvec& words);
+void fn_stat   (inode_state& state, const wordvec& words);
 command_fn find_command_fn (const string& command);
 
+// run_command -
+//    Runs a command in a session, holding the tree's lock shared if
+//    the command only reads the tree, or exclusive if it changes it,
+//    so that sessions on other threads may run commands at the same
+//    time.  Throws command_error for an unknown command.
+
+void run_command (inode_state& state, const wordvec& words);
+
+// call_stats -
+//    The calls of each command run by run_command, and how long each
+//    took, counting the wait for the tree's lock.  Printed by stat.
+
+extern command_stats call_stats;
+
+// run_line -
+//    Runs the words of one line of input, and returns the command it
+//    ran, for the journal, or no words if it ran none.  Blank lines
+//    and comments run nothing.  A make whose last word is <<tag
+//    opens a here document:  make runs without that word, and each
+//    line after it, up to one that is just tag, is added to the
+//    file by an append command.  So a large file can be written a
+//    line at a time, each taking time for that line only.  If the
+//    make fails, the lines are skipped.
+
+wordvec run_line (inode_state& state, const wordvec& words);
+
 // exit_status_message -
 //    Prints an exit message and returns the exit status, as recorded
 //    by any of the functions.
@@ -0,0 +1,164 @@
+// $Id: dirents.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+using namespace std;
+
+#include "debug.h"
+#include "dirents.h"
+
+static constexpr size_t NOT_FOUND = static_cast<size_t> (-1);
+
+static size_t hash_name (string_view name) {
+   return hash<string_view>{} (name);
+}
+
+dirent_index::dirent_index(): table (MIN_CAPACITY) {
+}
+
+dirent_index::dirent_index (const dirent_index& that):
+              entries (that.entries), table (that.table),
+              order_valid (entries.empty()) {
+}
+
+// find_slot -
+//    The table slot holding name, or NOT_FOUND.
+size_t dirent_index::find_slot (string_view name, size_t hash) const {
+   uint32_t hash_bits = static_cast<uint32_t> (hash);
+   for (size_t index = hash & mask();; index = (index + 1) & mask()) {
+      const slot& probe = table[index];
+      if (probe.position == 0) return NOT_FOUND;
+      if (probe.hash_bits == hash_bits
+          and entries[probe.position - 1].name == name) return index;
+   }
+}
+
+// find_position -
+//    The table slot that refers to the entry at position.
+size_t dirent_index::find_position (size_t position) const {
+   size_t index = entries[position].hash & mask();
+   while (table[index].position != position + 1) {
+      index = (index + 1) & mask();
+   }
+   return index;
+}
+
+void dirent_index::rehash (size_t capacity) {
+   DEBUGF ('i', "capacity " << table.size() << " -> " << capacity);
+   table.assign (capacity, slot());
+   for (size_t position = 0; position < entries.size(); ++position) {
+      size_t index = entries[position].hash & mask();
+      while (table[index].position != 0) index = (index + 1) & mask();
+      table[index].hash_bits = static_cast<uint32_t>
+                               (entries[position].hash);
+      table[index].position = static_cast<uint32_t> (position + 1);
+   }
+}
+
+inode_ptr dirent_index::find (string_view name) const {
+   size_t index = find_slot (name, hash_name (name));
+   if (index == NOT_FOUND) return nullptr;
+   return entries[table[index].position - 1].node;
+}
+
+bool dirent_index::insert (const string& name, inode_ptr node) {
+   size_t hash = hash_name (name);
+   if (find_slot (name, hash) != NOT_FOUND) return false;
+   // Keep the load factor at most 3/4.
+   if ((entries.size() + 1) * 4 > table.size() * 3) {
+      rehash (table.size() * 2);
+   }
+   if (order_valid and not entries.empty()
+       and name <= order.back()->name) order_valid = false;
+   const dirent* old_data = entries.data();
+   entries.push_back ({name, node, hash});
+   if (entries.data() != old_data) order_valid = false;
+   if (order_valid) order.push_back (&entries.back());
+   size_t index = hash & mask();
+   while (table[index].position != 0) index = (index + 1) & mask();
+   table[index].hash_bits = static_cast<uint32_t> (hash);
+   table[index].position = static_cast<uint32_t> (entries.size());
+   return true;
+}
+
+bool dirent_index::replace (string_view name, inode_ptr node) {
+   size_t index = find_slot (name, hash_name (name));
+   if (index == NOT_FOUND) return false;
+   entries[table[index].position - 1].node = node;
+   return true;
+}
+
+bool dirent_index::erase (string_view name) {
+   size_t hole = find_slot (name, hash_name (name));
+   if (hole == NOT_FOUND) return false;
+   order_valid = false;
+   size_t position = table[hole].position - 1;
+   // Backward shift: pull later entries of the probe run into the
+   // hole, unless that would move them before their home slot.
+   for (size_t next = (hole + 1) & mask(); table[next].position != 0;
+        next = (next + 1) & mask()) {
+      size_t home = table[next].hash_bits & mask();
+      bool movable = hole <= next ? home <= hole or home > next
+                                  : home <= hole and home > next;
+      if (movable) {
+         table[hole] = table[next];
+         hole = next;
+      }
+   }
+   table[hole] = slot();
+   // Move the last entry into the hole in the entry vector.
+   size_t last = entries.size() - 1;
+   if (position != last) {
+      table[find_position (last)].position
+            = static_cast<uint32_t> (position + 1);
+      entries[position] = move (entries[last]);
+   }
+   entries.pop_back();
+   return true;
+}
+
+size_t dirent_index::bytes() const {
+   return entries.capacity() * sizeof (dirent)
+        + table.capacity() * sizeof (slot)
+        + order.capacity() * sizeof (const dirent*);
+}
+
+size_t dirent_index::name_bytes() const {
+   // Names no longer than an empty string's capacity are stored in
+   // the string itself.
+   static const size_t inline_capacity = string().capacity();
+   size_t bytes = 0;
+   for (const dirent& entry: entries) {
+      if (entry.name.capacity() > inline_capacity) {
+         bytes += entry.name.capacity() + 1;
+      }
+   }
+   return bytes;
+}
+
+void dirent_index::reserve (size_t count) {
+   const dirent* old_data = entries.data();
+   entries.reserve (count);
+   if (entries.data() != old_data) order_valid = false;
+   size_t capacity = table.size();
+   while (count * 4 > capacity * 3) capacity *= 2;
+   if (capacity != table.size()) rehash (capacity);
+}
+
+const vector<const dirent*>& dirent_index::sorted() const {
+   if (not order_valid.load (memory_order_acquire)) {
+      lock_guard<mutex> guard (order_lock);
+      if (order_valid) return order;
+      order.clear();
+      order.reserve (entries.size());
+      for (const auto& entry: entries) order.push_back (&entry);
+      sort (order.begin(), order.end(),
+            [] (const dirent* left, const dirent* right) {
+               return left->name < right->name;
+            });
+      order_valid.store (true, memory_order_release);
+   }
+   return order;
+}
+
@@ -0,0 +1,128 @@
+// $Id: dirents.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#ifndef __DIRENTS_H__
+#define __DIRENTS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "arena.h"
+
+class inode;
+using inode_ptr = handle<inode>;
+
+// dirent -
+//    One directory entry:  the name, the inode it names, and the
+//    hash of the name, kept so the index can be rebuilt without
+//    rehashing every name.
+
+struct dirent {
+   string name;
+   inode_ptr node;
+   size_t hash;
+};
+
+// subtree_totals -
+//    The total size of the plain files in a subtree, and the number
+//    of files and of directories in it, counting its root.  Kept by
+//    each directory and updated up the path on every change, so du
+//    need not walk the subtree.
+
+struct subtree_totals {
+   size_t bytes {0};
+   size_t files {0};
+   size_t directories {0};
+   subtree_totals& operator+= (const subtree_totals& that) {
+      bytes += that.bytes;
+      files += that.files;
+      directories += that.directories;
+      return *this;
+   }
+   subtree_totals& operator-= (const subtree_totals& that) {
+      bytes -= that.bytes;
+      files -= that.files;
+      directories -= that.directories;
+      return *this;
+   }
+};
+
+// dirent_index -
+//    The entries of one directory, stored for directories with
+//    millions of entries.  The entries themselves are kept densely
+//    in one vector.  Lookup goes through an open addressing hash
+//    table with linear probing, where each slot is just 8 bytes:
+//    the low 32 bits of the hash and the position of the entry.
+//    A probe compares the stored hash bits before touching the
+//    entry, so a lookup usually reads one or two cache lines.
+//    Removal uses backward shift deletion, so there are no
+//    tombstones, and the last entry is moved into the hole.
+// find -
+//    Returns the inode named, or nullptr.
+// insert -
+//    Adds an entry.  Returns false, changing nothing, if the name
+//    is already present.
+// replace -
+//    Makes an existing entry name a different inode.  Returns false
+//    if the name is not present.
+// erase -
+//    Removes an entry.  Returns false if the name is not present.
+// reserve -
+//    Makes room for a number of entries without rehashing.
+// begin, end -
+//    The entries in no particular order.
+// bytes -
+//    The memory held by the index, not counting names too long to
+//    be stored in their string, which name_bytes counts.
+// sorted -
+//    The entries in lexicographic order of name, for ls.  The order
+//    is built lazily on the first call after a change and kept until
+//    the next change, except that inserting a name greater than all
+//    others just appends it.  The pointers are invalidated by any
+//    change to the index.  A copy of an index builds its own order.
+//    Sessions reading the tree together may each call it, so the
+//    order is built under a lock.
+
+class dirent_index {
+   private:
+      struct slot {
+         uint32_t hash_bits {0};
+         uint32_t position {0};  // entry index + 1, 0 if empty
+      };
+      static constexpr size_t MIN_CAPACITY = 8;
+      vector<dirent> entries;
+      vector<slot> table;
+      mutable vector<const dirent*> order;
+      mutable atomic<bool> order_valid {true};
+      mutable mutex order_lock;
+      size_t mask() const { return table.size() - 1; }
+      size_t find_slot (string_view name, size_t hash) const;
+      size_t find_position (size_t position) const;
+      void rehash (size_t capacity);
+   public:
+      dirent_index();
+      dirent_index (const dirent_index&);
+      dirent_index& operator= (const dirent_index&) = delete;
+      size_t size() const { return entries.size(); }
+      inode_ptr find (string_view name) const;
+      bool insert (const string& name, inode_ptr node);
+      bool replace (string_view name, inode_ptr node);
+      bool erase (string_view name);
+      void reserve (size_t count);
+      size_t bytes() const;
+      size_t name_bytes() const;
+      vector<dirent>::const_iterator begin() const {
+         return entries.cbegin();
+      }
+      vector<dirent>::const_iterator end() const {
+         return entries.cend();
+      }
+      const vector<const dirent*>& sorted() const;
+};
+
+#endif
+
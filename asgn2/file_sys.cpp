@@ -2,16 +2,23 @@
 //By: Zhuoxuan Wang (zwang437@ucsc.edu)
 //and Xiong Lou (xlou2@ucsc.edu)
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
-#include <sstream>
+#include <unordered_set>
 #include <stack>
 #include "commands.h"
 using namespace std;
 
+#include "blobs.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "image.h"
+#include "wildcard.h"
+#include "workers.h"
 
 int inode::next_inode_nr {1};
 
@@ -29,99 +36,694 @@ ostream& operator<< (ostream& out, file_type type) {
    return out << hash[type];
 }
 
-inode_state::inode_state() {
-    root = (new inode(file_type::DIRECTORY_TYPE, nullptr, "/")) ->get_ptr();
-    cwd = root;
-    DEBUGF ('i', "root = " << root << ", cwd = " << cwd
+file_tree::file_tree() {
+    root = inodes.make(file_type::DIRECTORY_TYPE, epoch);
+}
+inode_state::inode_state(): inode_state(make_shared<file_tree>()) {
+}
+inode_state::inode_state(shared_ptr<file_tree> tree_): tree (tree_) {
+    // Other sessions may be changing the root.
+    shared_lock<shared_mutex> reading(tree->lock);
+    cwd = tree->root;
+    seen_changes = tree->changes;
+    DEBUGF ('i', "root = " << tree->root << ", cwd = " << cwd
           << ", prompt = \"" << prompt() << "\"");
 }
+void inode_state::refresh() {
+    if(seen_changes == tree->changes) return;
+    seen_changes = tree->changes;
+    inode_ptr node = get_inode_from_path(pwd, false);
+    if(node == nullptr || node->f_type != file_type::DIRECTORY_TYPE) {
+        node = tree->root;
+        pwd = "/";
+    }
+    cwd = node;
+}
 directory_ptr inode_state::get_cur_dir() {
-    return dynamic_pointer_cast<directory> (cwd->contents);
+    refresh();
+    return cwd->get_dir();
 }
-inode_ptr  inode_state::get_inode_from_path(const string& path, bool ignore_last_node) {
-    std::vector<std::string> sv;
-    split(path, sv, '/');
-    inode_ptr cursor = cwd;
-    if(path.size() > 0 && path.at(0) == '/') {
-        cursor = root;
+const string& inode_state::normalize_path (string_view path,
+                                           bool ignore_last_node) {
+    if(ignore_last_node) {
+        string_view last = path_components(path).last();
+        path = path.substr(0, last.data() - path.data());
     }
-    size_t i = 0, j = sv.size();
-    if(ignore_last_node) j--;
-
-    for(; i < j; i++) {
-        if(sv.at(i).empty() || sv.at(i) == ".") {
-            continue;
+    if(path.empty() || path.at(0) != '/') {
+        path_buffer = pwd;
+        if(path_buffer == "/") path_buffer.clear();
+    } else {
+        path_buffer.clear();
+    }
+    for(string_view name : path_components(path)) {
+        if(name == ".") continue;
+        if(name == "..") {
+            size_t slash = path_buffer.find_last_of('/');
+            path_buffer.resize(slash == string::npos ? 0 : slash);
+        } else {
+            path_buffer += '/';
+            path_buffer.append(name);
         }
+    }
+    if(path_buffer.empty()) path_buffer = "/";
+    return path_buffer;
+}
+string inode_state::full_path(string_view path) {
+    return normalize_path(path, false);
+}
+inode_ptr  inode_state::get_inode_from_path(string_view path, bool ignore_last_node) {
+    const string& normalized = normalize_path(path, ignore_last_node);
+    {
+        shared_lock<shared_mutex> reading(tree->cache_lock);
+        auto cached = tree->dentry_cache.find(normalized);
+        if(cached != tree->dentry_cache.end()
+           && cached->second.generation == tree->dentry_generation) {
+            ++tree->dentry_hits;
+            DEBUGF ('d', "hit " << normalized);
+            return cached->second.node;
+        }
+    }
+    ++tree->dentry_misses;
+    DEBUGF ('d', "miss " << normalized);
+    inode_ptr cursor = tree->root;
+    for(string_view name : path_components(normalized)) {
         directory_ptr dir = cursor->get_dir();
-        if(dir->dirents.count(sv.at(i)) > 0) {
-            cursor = dir->dirents[sv.at(i)];
-        } else {
-            return nullptr;
+        if(dir == nullptr) return nullptr;
+        inode_ptr entry = dir->entries().find(name);
+        if(entry == nullptr) return nullptr;
+        cursor = entry;
+    }
+    unique_lock<shared_mutex> writing(tree->cache_lock);
+    auto& cache = tree->dentry_cache;
+    if(cache.size() >= tree->dentry_sweep_size) {
+        for(auto itor = cache.begin(); itor != cache.end(); ) {
+            if(itor->second.generation != tree->dentry_generation) {
+                itor = cache.erase(itor);
+            } else {
+                ++itor;
+            }
         }
+        tree->dentry_sweep_size = 2 * cache.size() + 64;
     }
+    cache[normalized] = {cursor, tree->dentry_generation};
     return cursor;
 }
-directory_ptr  inode_state::get_dir_from_path(const string& path) {
-    inode_ptr node = get_inode_from_path(path, false);
-    return node == nullptr ? nullptr : node->get_dir();
+void inode_state::forget_path(string_view path, bool subtree) {
+    string normalized = normalize_path(path, false);
+    unique_lock<shared_mutex> writing(tree->cache_lock);
+    if(!subtree) {
+        tree->dentry_invalidations += tree->dentry_cache.erase(normalized);
+        DEBUGF ('d', "forget " << normalized);
+        return;
+    }
+    ++tree->dentry_generation;
+    ++tree->dentry_invalidations;
+    // Any session's cwd may have been below it.
+    ++tree->changes;
+    DEBUGF ('d', "forget " << normalized << " and below");
+}
+static vector<string_view> file_words(plain_file_ptr file) {
+    vector<string_view> words;
+    words.reserve(file->word_count());
+    for(size_t index = 0; index < file->word_count(); ++index) {
+        words.push_back(file->word(index));
+    }
+    return words;
 }
-void inode_state::update_pwd(const string &path) {
-    std::vector<std::string> sv;
-    split(path, sv, '/');
-    if(path.size() > 0 && path.at(0) == '/') {
-        pwd = path;
+subtree_totals inode_state::totals_of(inode_ptr node) {
+    subtree_totals totals;
+    if(node == nullptr) return totals;
+    directory_ptr dir = node->get_dir();
+    if(dir != nullptr) return dir->get_totals();
+    totals.bytes = node->size();
+    totals.files = 1;
+    return totals;
+}
+void inode_state::update_totals(string_view path,
+                                const subtree_totals& before,
+                                const subtree_totals& after) {
+    string parent = normalize_path(path, true);
+    directory_ptr dir = tree->root->get_dir();
+    dir->totals += after;
+    dir->totals -= before;
+    for(string_view name : path_components(parent)) {
+        dir = dir->entries().find(name)->get_dir();
+        dir->totals += after;
+        dir->totals -= before;
+    }
+}
+void file_tree::index_file(inode_ptr file, const string& path) {
+    if(!index_valid || file->f_type != file_type::PLAIN_TYPE) return;
+    content_index.add(file->inode_nr, file, path,
+                      file_words(file->get_file()));
+}
+void inode_state::index_file(inode_ptr file, string_view path) {
+    tree->index_file(file, normalize_path(path, false));
+}
+void inode_state::index_appended(inode_ptr file, word_range words) {
+    if(!tree->index_valid) return;
+    tree->content_index.extend(file->inode_nr, file,
+                               vector<string_view>(words.first,
+                                                   words.second));
+}
+void file_tree::unindex_file(inode_ptr file) {
+    if(!index_valid || file->f_type != file_type::PLAIN_TYPE) return;
+    content_index.remove(file->inode_nr, file,
+                         file_words(file->get_file()));
+}
+void file_tree::rebuild_index() {
+    content_index.clear();
+    vector<pair<inode_ptr,string>> pending {{root, ""}};
+    while(!pending.empty()) {
+        auto [node, path] = move(pending.back());
+        pending.pop_back();
+        directory_ptr dir = node->get_dir();
+        if(dir == nullptr) {
+            content_index.add(node->inode_nr, node, path,
+                              file_words(node->get_file()));
+            continue;
+        }
+        for(const dirent& entry : dir->entries()) {
+            pending.emplace_back(entry.node, path + "/" + entry.name);
+        }
+    }
+    index_valid = true;
+    DEBUGS ('g', content_index.print_stats(cerr));
+}
+void inode_state::grep(const string& word, string_view path,
+                       ostream& out) {
+    // Nothing removed may still be waiting to be unindexed.
+    tree->reclaims.drain();
+    if(!tree->index_valid) tree->rebuild_index();
+    inode_ptr top = get_inode_from_path(path, false);
+    if(top == nullptr) {
+        throw command_error (string(path) + ": No such file or directory");
+    }
+    string top_path = normalize_path(path, false);
+    string prefix = top_path == "/" ? top_path : top_path + "/";
+    vector<indexed_file> found = tree->content_index.find(word);
+    vector<const string*> matches;
+    for(const indexed_file& each : found) {
+        if(each.file == nullptr
+           || get_inode_from_path(each.path, false) != each.file) {
+            tree->content_index.prune(word, each.number, each.file);
+            continue;
+        }
+        if(each.file == top
+           || each.path.compare(0, prefix.size(), prefix) == 0) {
+            matches.push_back(&each.path);
+        }
+    }
+    sort(matches.begin(), matches.end(),
+         [](const string* left, const string* right) {
+             return *left < *right;
+         });
+    for(const string* match : matches) out << *match << endl;
+}
+wordvec inode_state::glob(const string& pattern) {
+    if(!wildcard::has_magic(pattern)) return {pattern};
+    struct part {
+        bool any_depth;
+        wildcard name;
+    };
+    vector<part> parts;
+    for(string_view name : path_components(normalize_path(pattern, false))) {
+        parts.push_back({name == "**", wildcard(name)});
+    }
+    struct match {
+        inode_ptr node;
+        string path;
+    };
+    vector<match> found {{tree->root, ""}};
+    for(size_t index = 0; index < parts.size(); ++index) {
+        const part& each = parts[index];
+        bool last = index + 1 == parts.size();
+        vector<match> next;
+        auto add = [&](inode_ptr node, const string& path) {
+            if(last || node->f_type == file_type::DIRECTORY_TYPE) {
+                next.push_back({node, path});
+            }
+        };
+        for(const match& from : found) {
+            directory_ptr dir = from.node->get_dir();
+            if(dir == nullptr) continue;
+            if(each.any_depth) {
+                if(!last) add(from.node, from.path);
+                vector<match> pending {from};
+                while(!pending.empty()) {
+                    match below = move(pending.back());
+                    pending.pop_back();
+                    directory_ptr subdir = below.node->get_dir();
+                    for(const dirent& entry : subdir->entries()) {
+                        if(entry.name[0] == '.') continue;
+                        string path = below.path + "/" + entry.name;
+                        add(entry.node, path);
+                        if(entry.node->f_type == file_type::DIRECTORY_TYPE) {
+                            pending.push_back({entry.node, path});
+                        }
+                    }
+                }
+            } else if(each.name.is_literal()) {
+                inode_ptr child = dir->entries().find(each.name.literal());
+                if(child != nullptr) {
+                    add(child, from.path + "/" + each.name.literal());
+                }
+            } else {
+                for(const dirent* entry : dir->entries().sorted()) {
+                    if(each.name.match(entry->name)) {
+                        add(entry->node, from.path + "/" + entry->name);
+                    }
+                }
+            }
+        }
+        found = move(next);
+    }
+    wordvec paths;
+    for(const match& each : found) {
+        paths.push_back(each.path.empty() ? "/" : each.path);
+    }
+    sort(paths.begin(), paths.end());
+    paths.erase(unique(paths.begin(), paths.end()), paths.end());
+    DEBUGF ('g', pattern << ": " << paths.size() << " matches");
+    if(paths.empty()) paths.push_back(pattern);
+    return paths;
+}
+string inode_state::target_path(const string& source, string_view to) {
+    string target = normalize_path(to, false);
+    inode_ptr node = get_inode_from_path(target, false);
+    if(node != nullptr && node->f_type == file_type::DIRECTORY_TYPE) {
+        if(target.size() > 1) target += '/';
+        target.append(path_components(source).last());
+    }
+    string prefix = source == "/" ? source : source + "/";
+    if(target.compare(0, prefix.size(), prefix) == 0) {
+        throw command_error (string(to) + ": is inside " + source);
+    }
+    return target;
+}
+inode_ptr inode_state::copy_tree(inode_ptr from, const string& path) {
+    inode_ptr copy = tree->inodes.make(from->f_type, tree->epoch);
+    directory_ptr dir = from->get_dir();
+    if(dir == nullptr) {
+        copy->contents = from->contents->clone(copy);
+        tree->index_file(copy, path);
+        return copy;
+    }
+    directory_ptr into = copy->get_dir();
+    const vector<const dirent*>& sorted = dir->entries().sorted();
+    // In order, so the copy's sorted order is built as it goes.
+    into->dirents.reserve(sorted.size());
+    for(const dirent* entry : sorted) {
+        into->dirents.insert(entry->name,
+                             copy_tree(entry->node, path + "/" + entry->name));
+    }
+    into->totals = dir->totals;
+    return copy;
+}
+void inode_state::copy_path(string_view from, string_view to,
+                            bool recursive) {
+    string source = normalize_path(from, false);
+    inode_ptr node = get_inode_from_path(source, false);
+    if(node == nullptr) {
+        throw command_error (string(from) + ": No such file or directory");
+    }
+    if(node->f_type == file_type::DIRECTORY_TYPE && !recursive) {
+        throw command_error (string(from) + ": is a directory");
+    }
+    string target = target_path(source, to);
+    if(target == source) {
+        throw command_error (string(from) + ": is the same as " + target);
+    }
+    inode_ptr parent = get_inode_from_path(target, true);
+    if(parent == nullptr || parent->f_type != file_type::DIRECTORY_TYPE) {
+        throw command_error (string(to) + ": No such directory");
+    }
+    inode_ptr old = get_inode_from_path(target, false);
+    if(old != nullptr) {
+        if(old->f_type == file_type::DIRECTORY_TYPE
+           || node->f_type == file_type::DIRECTORY_TYPE) {
+            throw command_error (target + ": File exists");
+        }
+        // After a snapshot, the writable inode is a copy, and the
+        // index still names this one.
+        unindex_file(old);
+        inode_ptr file = get_writable_inode(target, false);
+        subtree_totals before = totals_of(file);
+        file->contents = node->contents->clone(file);
+        tree->index_file(file, target);
+        update_totals(target, before, totals_of(file));
         return;
-    } else {
-        pwd += "/";
-        pwd += path;
     }
+    directory_ptr into = get_writable_inode(target, true)->get_dir();
+    inode_ptr copy = copy_tree(node, target);
+    into->link(string(path_components(target).last()), copy);
+    update_totals(target, {}, totals_of(copy));
+    forget_path(target, false);
 }
-string inode_state::get_name_from_path(const string& path) {
-    std::vector<std::string> sv;
-    split(path, sv, '/');
-    if(sv.size() > 0) {
-        return sv.at(sv.size() - 1);
+void inode_state::move_path(string_view from, string_view to) {
+    string source = normalize_path(from, false);
+    inode_ptr node = get_inode_from_path(source, false);
+    if(node == nullptr) {
+        throw command_error (string(from) + ": No such file or directory");
+    }
+    string target = target_path(source, to);
+    if(target == source) return;
+    inode_ptr parent = get_inode_from_path(target, true);
+    if(parent == nullptr || parent->f_type != file_type::DIRECTORY_TYPE) {
+        throw command_error (string(to) + ": No such directory");
+    }
+    inode_ptr old = get_inode_from_path(target, false);
+    if(old != nullptr
+       && (old->f_type == file_type::DIRECTORY_TYPE
+           || node->f_type == file_type::DIRECTORY_TYPE)) {
+        throw command_error (target + ": File exists");
+    }
+    // Directories already of this epoch are not copied again, so the
+    // second copy leaves the first directory in place.
+    directory_ptr into = get_writable_inode(target, true)->get_dir();
+    directory_ptr out_of = get_writable_inode(source, true)->get_dir();
+    inode_ptr moved = out_of->remove(path_components(source).last(), true);
+    update_totals(source, totals_of(moved), {});
+    inode_ptr replaced = into->link(string(path_components(target).last()),
+                                    moved);
+    update_totals(target, totals_of(replaced), totals_of(moved));
+    reclaim(replaced);
+    if(moved->f_type == file_type::PLAIN_TYPE) {
+        tree->content_index.rename(moved->inode_nr, moved, target);
     } else {
-        return nullptr;
+        // The paths of everything below it have changed.
+        tree->index_valid = false;
     }
+    forget_path(source, moved->f_type != file_type::PLAIN_TYPE);
+    forget_path(target, false);
+}
 
+void inode_state::reclaim(inode_ptr node) {
+    if(node == nullptr) return;
+    if(node->epoch == tree->epoch) {
+        tree->reclaims.detach(node, tree->epoch);
+    } else {
+        // Kept for a snapshot, but no longer in the live tree.
+        unindex_file(node);
+    }
+}
+void inode_state::print_dentry_stats(ostream& out) const {
+    shared_lock<shared_mutex> reading(tree->cache_lock);
+    out << "dentry cache: " << tree->dentry_cache.size() << " entries, "
+        << tree->dentry_hits << " hits, " << tree->dentry_misses
+        << " misses, " << tree->dentry_invalidations << " invalidations"
+        << endl;
+}
+void inode_state::print_inode_stats(ostream& out) const {
+    out << "inodes: " << tree->inodes.size() << " live, "
+        << tree->inodes.freed_count() << " freed, "
+        << tree->inodes.capacity() << " slots" << endl;
+    tree->reclaims.print_stats(out);
+    tree->content_index.print_stats(out);
+    blob_store::print_stats(out);
+}
+void inode_state::print_memory(ostream& out) {
+    // Nothing may be freed while the arena is walked.
+    tree->reclaims.drain();
+    size_t files = 0;
+    size_t directories = 0;
+    size_t unread = 0;
+    size_t entries = 0;
+    size_t name_bytes = 0;
+    size_t index_bytes = 0;
+    size_t blob_bytes = 0;
+    size_t mapped_bytes = 0;
+    unordered_set<const blob*> blobs;
+    tree->inodes.for_each([&](inode_ptr node) {
+        directory_ptr dir = node->get_dir();
+        if(dir == nullptr) {
+            ++files;
+            const blob* held = node->get_file()->held();
+            if(held == nullptr) {
+                mapped_bytes += node->size();
+            } else if(blobs.insert(held).second) {
+                blob_bytes += sizeof (blob) + held->text.capacity()
+                            + held->word_starts.capacity() * sizeof (size_t);
+            }
+            return;
+        }
+        ++directories;
+        if(dir->mapped) ++unread;
+        entries += dir->dirents.size();
+        name_bytes += dir->dirents.name_bytes();
+        index_bytes += dir->dirents.bytes();
+    });
+    out << "files: " << files << " plain, " << directories
+        << " directories, " << unread << " not yet read from an image"
+        << endl;
+    out << "inode memory: " << tree->inodes.capacity() << " slots of "
+        << tree->inodes.slot_size() << " bytes, "
+        << files * sizeof (plain_file) + directories * sizeof (directory)
+        << " bytes of files and directories" << endl;
+    out << "directory entries: " << entries << ", " << index_bytes
+        << " bytes of indexes, " << name_bytes << " bytes of long names"
+        << endl;
+    out << "file text: " << blobs.size() << " blobs of " << blob_bytes
+        << " bytes, " << mapped_bytes << " bytes mapped from images"
+        << endl;
+}
+inode_ptr inode_state::get_writable_inode(string_view path, bool ignore_last_node) {
+    inode_ptr node = get_inode_from_path(path, ignore_last_node);
+    // Inodes of this epoch are only reachable through other inodes of
+    // this epoch, so if the target is one, so is the whole path.
+    if(node == nullptr || node->epoch == tree->epoch) return node;
+    const string& normalized = normalize_path(path, ignore_last_node);
+    unsigned epoch = tree->epoch;
+    unique_lock<shared_mutex> writing(tree->cache_lock);
+    // Sessions in a copied directory must move to the copy.
+    ++tree->changes;
+    if(tree->root->epoch != epoch) {
+        tree->root = tree->inodes.make(*tree->root, epoch);
+        tree->dentry_invalidations += tree->dentry_cache.erase("/");
+    }
+    inode_ptr cursor = tree->root;
+    string prefix;
+    for(string_view name : path_components(normalized)) {
+        directory_ptr dir = cursor->get_dir();
+        inode_ptr child = dir->entries().find(name);
+        prefix += '/';
+        prefix.append(name);
+        if(child->epoch != epoch) {
+            inode_ptr copy = tree->inodes.make(*child, epoch);
+            dir->entries().replace(name, copy);
+            tree->dentry_invalidations += tree->dentry_cache.erase(prefix);
+            child = copy;
+        }
+        cursor = child;
+    }
+    DEBUGF ('s', "copied path " << normalized);
+    return cursor;
+}
+inode_ptr inode_state::find_snapshot(const string& name) const {
+    auto found = tree->snapshots.find(name);
+    return found == tree->snapshots.end() ? nullptr : found->second;
+}
+void inode_state::take_snapshot(const string& name) {
+    if(tree->snapshots.count(name) > 0) {
+        throw command_error ("snapshot " + name + " already exists");
+    }
+    tree->snapshots[name] = tree->root;
+    ++tree->epoch;
+    DEBUGF ('s', name << " = " << tree->root << ", epoch " << tree->epoch);
+}
+void inode_state::restore_snapshot(const string& name) {
+    inode_ptr snapshot = find_snapshot(name);
+    if(snapshot == nullptr) {
+        throw command_error ("no snapshot " + name);
+    }
+    ++tree->epoch;
+    replace_root(snapshot);
+}
+// replace_root -
+//    Makes another tree live, keeping the same pwd in each session
+//    if it exists there, and frees what is left of the old one.
+void inode_state::replace_root(inode_ptr new_root) {
+    tree->root = new_root;
+    tree->content_index.clear();
+    tree->index_valid = false;
+    {
+        unique_lock<shared_mutex> writing(tree->cache_lock);
+        ++tree->dentry_generation;
+        ++tree->dentry_invalidations;
+        ++tree->changes;
+    }
+    refresh();
+    collect();
+}
+void inode_state::save_image(const string& filename, uint64_t sequence) {
+    // Breadth first, so the entries of each directory are together
+    // and inode indexes are given out in the order they are added.
+    image_builder builder;
+    vector<inode_ptr> queue {tree->root};
+    uint32_t next_index = 1;
+    for(size_t head = 0; head < queue.size(); ++head) {
+        inode_ptr node = queue[head];
+        if(node->f_type == file_type::PLAIN_TYPE) {
+            builder.add_file(node->inode_nr, node->get_file()->readfile());
+            continue;
+        }
+        const auto& entries = node->get_dir()->entries().sorted();
+        builder.add_directory(node->inode_nr, builder.dirent_count(),
+                              entries.size());
+        for(const dirent* entry : entries) {
+            builder.add_dirent(entry->name, next_index++);
+            queue.push_back(entry->node);
+        }
+    }
+    builder.write(filename, sequence);
+}
+uint64_t inode_state::load_image(const string& filename) {
+    shared_ptr<const image> loaded = image::open(filename);
+    const disk_inode& top = loaded->inode_at(0);
+    if(!top.is_directory) {
+        throw file_error (filename + ": root is not a directory");
+    }
+    int max_nr = static_cast<int> (loaded->max_inode_nr());
+    inode::next_inode_nr = max(inode::next_inode_nr, max_nr + 1);
+    inode_ptr new_root = tree->inodes.make(file_type::DIRECTORY_TYPE,
+                                           tree->epoch,
+                                           static_cast<int> (top.inode_nr));
+    new_root->get_dir()->map(loaded, 0);
+    replace_root(new_root);
+    return loaded->sequence();
+}
+void inode_state::diff_snapshot(const string& from, const string& to,
+                                ostream& out) {
+    inode_ptr from_root = find_snapshot(from);
+    if(from_root == nullptr) {
+        throw command_error ("no snapshot " + from);
+    }
+    inode_ptr to_root = to.empty() ? tree->root : find_snapshot(to);
+    if(to_root == nullptr) {
+        throw command_error ("no snapshot " + to);
+    }
+    diff_tree(from_root, to_root, "/", out);
+}
+void inode_state::diff_tree(inode_ptr from, inode_ptr to,
+                            const string& path, ostream& out) {
+    if(from == to) return;
+    string slash = from->f_type == file_type::DIRECTORY_TYPE ? "/" : "";
+    if(from->f_type != to->f_type) {
+        out << "- " << path << slash << endl;
+        out << "+ " << path << (slash.empty() ? "/" : "") << endl;
+        return;
+    }
+    if(from->f_type == file_type::PLAIN_TYPE) {
+        if(from->get_file()->readfile() != to->get_file()->readfile()) {
+            out << "M " << path << endl;
+        }
+        return;
+    }
+    // Merge the two sorted listings.
+    const auto& from_entries = from->get_dir()->entries().sorted();
+    const auto& to_entries = to->get_dir()->entries().sorted();
+    string prefix = path == "/" ? path : path + "/";
+    auto print = [&](const char* change, const dirent* entry) {
+        out << change << prefix << entry->name;
+        if(entry->node->f_type == file_type::DIRECTORY_TYPE) out << "/";
+        out << endl;
+    };
+    auto from_itor = from_entries.begin();
+    auto to_itor = to_entries.begin();
+    while(from_itor != from_entries.end() || to_itor != to_entries.end()) {
+        if(to_itor == to_entries.end()
+           || (from_itor != from_entries.end()
+               && (*from_itor)->name < (*to_itor)->name)) {
+            print("- ", *from_itor++);
+        }else if(from_itor == from_entries.end()
+                 || (*to_itor)->name < (*from_itor)->name) {
+            print("+ ", *to_itor++);
+        }else {
+            diff_tree((*from_itor)->node, (*to_itor)->node,
+                      prefix + (*from_itor)->name, out);
+            ++from_itor;
+            ++to_itor;
+        }
+    }
+}
+void inode_state::list_snapshots(ostream& out) const {
+    for(const auto& snapshot : tree->snapshots) {
+        out << snapshot.first << endl;
+    }
+}
+// collect -
+//    Frees every inode not reachable from the live tree or from a
+//    snapshot.
+void inode_state::collect() {
+    tree->reclaims.drain();
+    vector<bool> marked(tree->inodes.capacity());
+    vector<inode_ptr> pending {tree->root};
+    for(const auto& snapshot : tree->snapshots) {
+        pending.push_back(snapshot.second);
+    }
+    while(!pending.empty()) {
+        inode_ptr node = pending.back();
+        pending.pop_back();
+        if(marked[node.get_index()]) continue;
+        marked[node.get_index()] = true;
+        directory_ptr dir = node->get_dir();
+        if(dir == nullptr) continue;
+        for(const dirent& entry : dir->dirents) {
+            pending.push_back(entry.node);
+        }
+    }
+    vector<inode_ptr> garbage;
+    tree->inodes.for_each([&](inode_ptr node) {
+        if(!marked[node.get_index()]) garbage.push_back(node);
+    });
+    for(inode_ptr node : garbage) tree->inodes.free(node);
+    DEBUGF ('s', "collected " << garbage.size() << " inodes");
+}
+directory_ptr  inode_state::get_dir_from_path(string_view path) {
+    inode_ptr node = get_inode_from_path(path, false);
+    return node == nullptr ? nullptr : node->get_dir();
+}
+void inode_state::update_pwd(string_view path) {
+    pwd = normalize_path(path, false);
+}
+string_view inode_state::get_name_from_path(string_view path) {
+    return path_components(path).last();
 }
 void inode_state::update_prompt(const string& prompt) {
     prompt_ = prompt + " ";
 }
-void inode_state::split(const std::string& s, std::vector<std::string>& sv, const char delim = ' ') {
-    sv.clear();
-    std::istringstream iss(s);
-    std::string temp;
-
-    while (std::getline(iss, temp, delim)) {
-        sv.emplace_back(std::move(temp));
-    }
-
-    return;
+const string& inode_state::prompt() const {
+    static const string continuation {"> "};
+    return here_end.empty() ? prompt_ : continuation;
 }
-const string& inode_state::prompt() const { return prompt_; }
 
 ostream& operator<< (ostream& out, const inode_state& state) {
-   out << "inode_state: root = " << state.root
+   out << "inode_state: root = " << state.get_root()
        << ", cwd = " << state.cwd;
    return out;
 }
 
-inode::inode(file_type type, inode_ptr parent, string full_path): inode_nr (next_inode_nr++) {
+inode::inode(inode_ptr self, file_type type, unsigned new_epoch):
+             inode (self, type, new_epoch, next_inode_nr++) {
+}
+inode::inode(inode_ptr self, file_type type, unsigned new_epoch, int nr): inode_nr (nr) {
     f_type = type;
-    path = full_path;
+    epoch = new_epoch;
     switch (type) {
       case file_type::PLAIN_TYPE:
-           contents = make_shared<plain_file>();
+           contents = make_unique<plain_file>();
            break;
       case file_type::DIRECTORY_TYPE:
-           inode_ptr ptr(this);
-           contents = make_shared<directory>(ptr, parent == nullptr ? ptr : parent);
+           contents = make_unique<directory>(self);
            break;
    }
    DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
 }
+inode::inode(inode_ptr self, const inode& that, unsigned new_epoch):
+             inode_nr (that.inode_nr), contents (that.contents->clone(self)),
+             f_type (that.f_type), epoch (new_epoch) {
+   DEBUGF ('i', "inode " << inode_nr << " copied, epoch " << epoch);
+}
 
 int inode::get_inode_nr() const {
    DEBUGF ('i', "inode = " << inode_nr);
@@ -135,22 +737,14 @@ file_type inode::get_file_type() {
 }
 directory_ptr inode::get_dir() {
     if(f_type == file_type::DIRECTORY_TYPE) {
-        return dynamic_pointer_cast<directory> (contents);
+        return static_cast<directory_ptr> (contents.get());
     } else {
         return nullptr;
     }
 }
 plain_file_ptr inode::get_file() {
     if(f_type == file_type::PLAIN_TYPE) {
-        return dynamic_pointer_cast<plain_file> (contents);
-    } else {
-        return nullptr;
-    }
-}
-inode_ptr inode::get_ptr() {
-    directory_ptr dict = get_dir();
-    if(dict != nullptr) {
-        return dict->dirents.at(".");
+        return static_cast<plain_file_ptr> (contents.get());
     } else {
         return nullptr;
     }
@@ -159,44 +753,108 @@ inode_ptr inode::get_ptr() {
 inode::~inode() {
     return;
 }
-void directory::ls(bool recursive) {
-    map<string,inode_ptr>::iterator itr;
-    int count = 0;
-    cout<<dirents["."]->path<<":"<<endl;
-    for (itr = dirents.begin(); itr != dirents.end(); ++itr) {
-        printf("%6d  %6zu", itr->second->get_inode_nr(), itr->second->size());
-        cout<< "  "<< itr->first;
-        if(itr->second->f_type == file_type::DIRECTORY_TYPE && count > 1) {
-            cout<< "/";
+static void format_dirent(string& out, const dirent& entry, bool is_dot) {
+    char numbers[64];
+    snprintf(numbers, sizeof numbers, "%6d  %6zu  ",
+             entry.node->get_inode_nr(), entry.node->size());
+    out += numbers;
+    out += entry.name;
+    if(entry.node->f_type == file_type::DIRECTORY_TYPE && !is_dot) {
+        out += '/';
+    }
+    out += '\n';
+}
+void directory::format(string& out, const string& path, inode_ptr parent,
+                       const vector<const dirent*>& sorted) const {
+    out += path;
+    out += ":\n";
+    // Merge dot and dotdot into the sorted listing.
+    const dirent dots[] {{".", self, 0}, {"..", parent, 0}};
+    const dirent* dot = begin(dots);
+    for (const dirent* entry : sorted) {
+        while (dot != end(dots) && dot->name < entry->name) {
+            format_dirent(out, *dot++, true);
         }
-        cout<<endl;
-        count++;
-    }
-    if(recursive) {
-        itr = dirents.begin();
-        itr ++;
-        itr ++;
-        for (; itr != dirents.end(); ++itr) {
-            if(itr->second->f_type == file_type::DIRECTORY_TYPE) {
-                itr->second->get_dir()->ls(true);
-            }
+        format_dirent(out, *entry, false);
+    }
+    while (dot != end(dots)) format_dirent(out, *dot++, true);
+}
+// listing -
+//    The text of one directory in lsr, and the listings of its
+//    subdirectories, in the order they are printed.
+struct directory::listing {
+    string text;
+    vector<listing> subdirs;
+};
+// list_tree -
+//    A task which lists one directory and spawns a task for each
+//    subdirectory.  The tasks only read the tree, and entries()
+//    makes the inodes of a directory mapped from an image once.
+void directory::list_tree(work_pool& pool, inode_ptr node, string path,
+                          inode_ptr parent, listing& into) {
+    directory_ptr dir = node->get_dir();
+    const vector<const dirent*>& sorted = dir->entries().sorted();
+    dir->format(into.text, path, parent, sorted);
+    if(path.size() > 1) path += '/';
+    size_t subdir_count = 0;
+    for (const dirent* entry : sorted) {
+        if(entry->node->f_type == file_type::DIRECTORY_TYPE) ++subdir_count;
+    }
+    // Sized before any task starts, so the listings never move.
+    into.subdirs.resize(subdir_count);
+    listing* subdir = into.subdirs.data();
+    for (const dirent* entry : sorted) {
+        if(entry->node->f_type != file_type::DIRECTORY_TYPE) continue;
+        inode_ptr child = entry->node;
+        string child_path = path + entry->name;
+        listing& child_listing = *subdir++;
+        pool.spawn([&pool, child, child_path, node, &child_listing] {
+            list_tree(pool, child, child_path, node, child_listing);
+        });
+    }
+}
+void directory::ls(ostream& out, const string& path, inode_ptr parent,
+                   bool recursive) {
+    if(!recursive) {
+        string text;
+        format(text, path, parent, entries().sorted());
+        out << text;
+        return;
+    }
+    // Kept for every lsr, so none waits for threads to start.
+    static work_pool pool;
+    listing tree;
+    pool.run([&] { list_tree(pool, self, path, parent, tree); });
+    // Print in preorder, as a sequential recursive ls would.
+    vector<const listing*> pending {&tree};
+    while(!pending.empty()) {
+        const listing* next = pending.back();
+        pending.pop_back();
+        out << next->text;
+        for (auto sub = next->subdirs.rbegin(); sub != next->subdirs.rend();
+             ++sub) {
+            pending.push_back(&*sub);
         }
     }
 }
-
+
 file_error::file_error (const string& what):
             runtime_error (what) {
 }
 
-const wordvec& base_file::readfile() const {
+string_view base_file::readfile() const {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::writefile (const wordvec&) {
+void base_file::writefile (word_range) {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::remove (const string&, bool recursive) {
+void base_file::appendfile (word_range) {
+   throw file_error ("is a " + error_file_type());
+}
+
+inode_ptr base_file::remove (string_view, bool recursive) {
    cout << "is recursive" << recursive;
    throw file_error ("is a " + error_file_type());
 }
@@ -205,105 +863,219 @@ inode_ptr base_file::mkdir (const string&) {
    throw file_error ("is a " + error_file_type());
 }
 
-inode_ptr base_file::mkfile (const string&, const wordvec& newdata) {
-    cout << "data size: " << newdata.size() << endl;
+inode_ptr base_file::mkfile (const string&, word_range newdata) {
+    cout << "data size: " << newdata.second - newdata.first << endl;
     throw file_error ("is a " + error_file_type());
 }
 
 
 size_t plain_file::size() const {
-   size_t data_size = 0;
-   if(data.size() == 0) return data_size;
-   for(size_t i = 0; i < data.size(); i++) {
-       data_size += data.at(i).size();
+   DEBUGF ('i', "size = " << text().size());
+   return text().size();
+}
+
+string_view plain_file::text() const {
+   if (source != nullptr) return mapped;
+   if (contents != nullptr) return contents->text;
+   return {};
+}
+
+void plain_file::map (shared_ptr<const image> image_, string_view text_) {
+   source = image_;
+   mapped = text_;
+   contents = nullptr;
+   word_starts.clear();
+   words_indexed = false;
+}
+
+base_file_ptr plain_file::clone(inode_ptr) const {
+   auto copy = make_unique<plain_file>();
+   copy->contents = contents;
+   copy->source = source;
+   copy->mapped = mapped;
+   copy->word_starts = word_starts;
+   copy->words_indexed = words_indexed;
+   return copy;
+}
+
+string_view plain_file::readfile() const {
+   DEBUGF ('i', text());
+   return text();
+}
+
+void plain_file::writefile (word_range words) {
+   source = nullptr;
+   mapped = {};
+   word_starts.clear();
+   word_starts.shrink_to_fit();
+   words_indexed = true;
+   contents = blob_store::intern (words);
+   DEBUGF ('i', contents->text);
+}
+
+void plain_file::appendfile (word_range words) {
+   if (words.first == words.second) return;
+   blob_store::append (contents, text(), starts(), words);
+   source = nullptr;
+   mapped = {};
+   word_starts.clear();
+   word_starts.shrink_to_fit();
+   words_indexed = true;
+   DEBUGF ('i', contents->text.size() << " bytes");
+}
+
+void plain_file::index_words() const {
+   string_view all = text();
+   word_starts.clear();
+   for (size_t start = 0; start < all.size();) {
+      word_starts.push_back (start);
+      size_t space = all.find (' ', start);
+      if (space == string_view::npos) break;
+      start = space + 1;
    }
-   data_size += data.size() - 1;
-   DEBUGF ('i', "size = " << data_size);
-   return data_size;
+   words_indexed = true;
+}
+
+const vector<size_t>& plain_file::starts() const {
+   if (contents != nullptr) return contents->word_starts;
+   if (not words_indexed) index_words();
+   return word_starts;
 }
 
-const wordvec& plain_file::readfile() const {
-   DEBUGF ('i', data);
-   return data;
+size_t plain_file::word_count() const {
+   return starts().size();
 }
 
-void plain_file::writefile (const wordvec& words) {
-   data = words;
-   DEBUGF ('i', words);
+string_view plain_file::word (size_t index) const {
+   const vector<size_t>& offsets = starts();
+   string_view all = text();
+   size_t start = offsets.at (index);
+   size_t end = index + 1 < offsets.size()
+              ? offsets[index + 1] - 1 : all.size();
+   return all.substr (start, end - start);
 }
 
 size_t directory::size() const {
-   size_t size = dirents.size();
+   // Dot and dotdot are not stored, but are counted.
+   if(mapped.load(memory_order_acquire)) {
+      lock_guard<mutex> guard(map_lock);
+      if(source != nullptr) return source->inode_at(source_index).count + 2;
+   }
+   size_t size = dirents.size() + 2;
    DEBUGF ('i', "size = " << size);
    return size;
 }
-directory::directory(inode_ptr cur, inode_ptr parent) {
-    dirents["."] = cur;
-    dirents[".."] = parent;
+directory::directory(inode_ptr self_): self (self_) {
+    totals.directories = 1;
 }
-void directory::remove (const string& filename, bool recursive) {
-    if(filename.empty() || filename.compare(".") == 0 || filename.compare("..") == 0) {
-        return;
+directory::directory(inode_ptr self_, const directory& that):
+           self (self_), dirents (that.dirents), totals (that.totals),
+           source (that.source), source_index (that.source_index),
+           mapped (that.source != nullptr) {
+}
+void directory::map(shared_ptr<const image> image_, uint64_t index) {
+    source = image_;
+    source_index = index;
+    totals = image_->totals_at(index);
+    mapped = true;
+}
+dirent_index& directory::entries() {
+    if(mapped.load(memory_order_acquire)) {
+        lock_guard<mutex> guard(map_lock);
+        if(source != nullptr) materialize();
+    }
+    return dirents;
+}
+// materialize -
+//    Makes inodes for the entries in the image, which are already
+//    sorted, so the sorted order of the index is built as they go.
+void directory::materialize() {
+    shared_ptr<const image> from = move(source);
+    source = nullptr;
+    const disk_inode& node = from->inode_at(source_index);
+    dirents.reserve(node.count);
+    for(uint64_t index = 0; index < node.count; ++index) {
+        const disk_dirent& entry = from->dirent_at(node.first + index);
+        const disk_inode& child = from->inode_at(entry.inode_index);
+        string name {from->name(entry)};
+        file_type type = child.is_directory ? file_type::DIRECTORY_TYPE
+                                            : file_type::PLAIN_TYPE;
+        inode_ptr ptr = self.get_arena()->make(type, self->epoch,
+                                               static_cast<int> (child.inode_nr));
+        if(child.is_directory) {
+            ptr->get_dir()->map(from, entry.inode_index);
+        } else {
+            ptr->get_file()->map(from, from->text(child));
+        }
+        dirents.insert(name, ptr);
     }
-    if(dirents.count(filename) <= 0) {
+    mapped.store(false, memory_order_release);
+    DEBUGF ('m', "inode " << self->get_inode_nr() << ": " << node.count
+           << " entries");
+}
+base_file_ptr directory::clone(inode_ptr self_) const {
+    return base_file_ptr (new directory (self_, *this));
+}
+inode_ptr directory::remove (string_view filename, bool recursive) {
+    if(filename.empty() || filename == "." || filename == "..") {
+        return nullptr;
+    }
+    inode_ptr entry = entries().find(filename);
+    if(entry == nullptr) {
         throw command_error ("No such file or directory.");
     }
-    if(dirents[filename]->get_file_type() == file_type::DIRECTORY_TYPE) {
-        if(dirents[filename]->get_dir()->dirents.size() > 2 && !recursive) {
+    if(entry->get_file_type() == file_type::DIRECTORY_TYPE) {
+        if(entry->get_dir()->size() > 2 && !recursive) {
             throw command_error ("directory not empty");
         }
 
     }
-    if(recursive && dirents[filename]->f_type == file_type::DIRECTORY_TYPE) {
-        directory_ptr sub_dir = dirents[filename]->get_dir();
-        map<string,inode_ptr>::iterator itr;
-        int count = 0;
-        for (itr = sub_dir->dirents.begin(); itr != sub_dir->dirents.end(); ++itr) {
-            if(count > 1) {
-                if(itr->second->f_type == file_type::DIRECTORY_TYPE) {
-                    sub_dir->remove(itr->first, true);
-                } else {
-                    sub_dir->remove(itr->first, false);
-                }
-            }
-            count++;
-        }
-    }
     dirents.erase(filename);
     DEBUGF ('i', filename);
+    return entry;
 }
 
 inode_ptr directory::mkdir (const string& dirname) {
    if(dirname.empty()) {
        throw command_error ("invalid argument ");
    }
-   if(dirents.count(dirname) > 0) {
+   if(entries().find(dirname) != nullptr) {
        throw command_error("directory or file exists.");
    }
-   string full_path = dirents["."]->path;
-   if(full_path.size() > 1) full_path += "/";
-   full_path += dirname;
-   inode_ptr ptr = (new inode(file_type::DIRECTORY_TYPE, dirents["."], full_path)) ->get_ptr();
-   dirents[dirname] = ptr;
+   inode_ptr ptr = self.get_arena()->make(file_type::DIRECTORY_TYPE, self->epoch);
+   dirents.insert(dirname, ptr);
    DEBUGF ('i', dirname);
    return ptr;
 }
 
-inode_ptr directory::mkfile (const string& filename, const wordvec& newdata) {
+inode_ptr directory::mkfile (const string& filename, word_range newdata) {
    if(filename.empty()) {
        throw command_error ("invalid argument ");
    }
-   if(dirents.count(filename) > 0) {
-       if(dirents[filename]->f_type ==file_type::DIRECTORY_TYPE)
+   inode_ptr file = entries().find(filename);
+   if(file != nullptr) {
+       if(file->f_type ==file_type::DIRECTORY_TYPE)
            throw command_error("make: " + filename + ": directory with same name already exists.");
+       if(file->epoch != self->epoch) {
+           // The old contents may be in a snapshot, so copy the file.
+           file = self.get_arena()->make(*file, self->epoch);
+           dirents.replace(filename, file);
+       }
    } else {
-       string full_path = dirents["."]->path;
-       if(full_path.size() > 1) full_path += "/";
-       full_path += filename;
-       dirents[filename] = make_shared<inode>(file_type::PLAIN_TYPE, nullptr, filename);
+       file = self.get_arena()->make(file_type::PLAIN_TYPE, self->epoch);
+       dirents.insert(filename, file);
    }
-   dirents[filename]->get_file()->writefile(newdata);
+   file->get_file()->writefile(newdata);
    DEBUGF ('i', filename);
-   return nullptr;
+   return file;
 }
 
+inode_ptr directory::link (const string& name, inode_ptr node) {
+   inode_ptr old = entries().find(name);
+   if(old == nullptr) {
+       dirents.insert(name, node);
+   } else {
+       dirents.replace(name, node);
+   }
+   return old;
+}
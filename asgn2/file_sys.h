@@ -3,60 +3,292 @@
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <atomic>
 #include <exception>
 #include <iostream>
-#include <memory>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
+#include "blobs.h"
+#include "dirents.h"
+#include "reclaim.h"
+#include "wordindex.h"
 #include "util.h"
 
 // inode_t -
 //    An inode is either a directory or a plain file.
 
 enum class file_type {PLAIN_TYPE, DIRECTORY_TYPE};
-class inode;
 class base_file;
 class plain_file;
 class directory;
-using inode_ptr = shared_ptr<inode>;
-using directory_ptr = shared_ptr<directory>;
-using plain_file_ptr = shared_ptr<plain_file>;
-using base_file_ptr = shared_ptr<base_file>;
+class image;
+class work_pool;
+using directory_ptr = directory*;
+using plain_file_ptr = plain_file*;
+using base_file_ptr = unique_ptr<base_file>;
 ostream& operator<< (ostream&, file_type);
 
 
+// file_tree -
+//    The tree shared by every session:  the root, the snapshots, the
+//    word index, and the dentry cache.  Every inode is owned by the
+//    tree's arena, and everything else refers to inodes by inode_ptr
+//    handles, which go stale when the inode is removed.
+//    Sessions run commands at the same time, each holding lock
+//    shared if the command only reads the tree, or exclusive if it
+//    changes it (see run_command).  Each change copies the path from
+//    the root (see Snapshots) and updates the totals of every
+//    directory on it, so every change writes the root, and a lock on
+//    each directory would serialize writers there anyway.  What a
+//    reader may change has a lock of its own:  the dentry cache has
+//    cache_lock, and each directory locks as it makes its inodes and
+//    sorts its entries.  The word index is only changed by commands
+//    holding lock exclusively, grep included, and by the reclaimer,
+//    which it has its own lock for.
+//    The server runs one command at a time, so only sessioncheck,
+//    which runs sessions on several threads, shares the lock.
+// changes -
+//    Counts the changes that may remove a session's cwd or replace
+//    it with a copy, so that each session looks it up again.
+// dentry_generation -
+//    Each cached dentry records the generation it was cached in, and
+//    is only used while that is still the current one.  Forgetting a
+//    subtree starts a new generation, which drops every dentry at
+//    once in O(1) time.  Stale dentries are swept out when the cache
+//    has doubled since the last sweep, so they cost amortized O(1)
+//    time for each one cached.
+
+class file_tree {
+   friend class inode_state;
+   private:
+      arena<inode> inodes;
+      word_index content_index;
+      atomic<bool> index_valid {true};
+      reclaimer reclaims {inodes, [this] (inode_ptr node) {
+         unindex_file (node);
+      }};
+      unsigned epoch {0};
+      map<string,inode_ptr> snapshots;
+      inode_ptr root {nullptr};
+      size_t changes {0};
+      struct dentry {
+         inode_ptr node;
+         size_t generation;
+      };
+      shared_mutex cache_lock;
+      unordered_map<string,dentry> dentry_cache;
+      size_t dentry_generation {0};
+      size_t dentry_sweep_size {64};
+      atomic<size_t> dentry_hits {0};
+      atomic<size_t> dentry_misses {0};
+      atomic<size_t> dentry_invalidations {0};
+      void index_file (inode_ptr file, const string& path);
+      void unindex_file (inode_ptr file);
+      void rebuild_index();
+   public:
+      shared_mutex lock;
+      file_tree();
+      file_tree (const file_tree&) = delete;
+      file_tree& operator= (const file_tree&) = delete;
+};
+
 // inode_state -
-//    A small convenient class to maintain the state of the simulated
-//    process:  the root (/), the current directory (.), and the
-//    prompt.
+//    A small convenient class to maintain the state of one session
+//    of the simulated process:  the current directory (.) and the
+//    prompt, and the tree it shares with every other session.  Each
+//    session is used by one thread at a time.
+// here_path, here_end -
+//    While a here document is open (see run_line), the file its
+//    lines are appended to, or empty if they are skipped, and the
+//    line that ends it.  The prompt is then "> ".
+// session_prompt -
+//    The prompt set by the prompt command, even while a here
+//    document is open, which is what the journal must record.
+// refresh -
+//    Looks up cwd again if the tree has changed under it, going
+//    back to the root if it is gone.  Called before each command.
+// get_inode_from_path -
+//    Resolves a path relative to cwd.  The path is first normalized
+//    to an absolute path without ".", "..", or empty components,
+//    and that is looked up in the dentry cache before walking the
+//    tree.  Only successful lookups are cached.  Paths are walked
+//    with path_components, and the normalized path is built in a
+//    reused buffer, so a cache hit allocates nothing.
+// forget_path -
+//    Drops a path and everything below it from the dentry cache.
+//    Must be called after any command that removes or creates the
+//    entry named by the path.  Creating an entry or removing a plain
+//    file changes nothing below it, so then subtree may be false,
+//    which drops just that path.  Otherwise the whole cache is
+//    dropped by starting a new generation.  Either takes O(1) time.
+// reclaim -
+//    Frees an inode just removed from its directory, and everything
+//    below it, on the reclaimer's thread (see reclaim.h).  Inodes
+//    from an older epoch may be in a snapshot and are kept.
+// index_file, unindex_file -
+//    Add the words of a file in the live tree to the word index,
+//    under the path it is at, or remove them, which must be done
+//    before its contents change.  Files freed by the reclaimer are
+//    unindexed as they are freed.
+// index_appended -
+//    Adds words just appended to an indexed file to the word index,
+//    in time proportional to the words, not the file.
+// full_path -
+//    The absolute path a path names, without ".", "..", or empty
+//    components, as get_inode_from_path looks it up.
+// totals_of -
+//    The subtree totals of a directory, or of one plain file.
+// update_totals -
+//    After a change to the entry named by a path, adds the totals
+//    after the change and subtracts those before from each directory
+//    above it.  Those directories must all be of this epoch, as
+//    get_writable_inode leaves them, since the totals of one shared
+//    with a snapshot must not change.
+// glob -
+//    Expands a pattern (see wildcard.h) into the sorted absolute
+//    paths that match it, or returns it unchanged if it has no
+//    magic or matches nothing.  A component ** matches zero or more
+//    directories, or everything below when last.  Each component is
+//    compiled once, literal components are looked up instead of
+//    matched, and only directories are followed, so only the
+//    directories that can lead to a match are read.
+// grep -
+//    Prints the paths of the files under a path that contain a word,
+//    in order.  The word index answers in time proportional to the
+//    number of files containing the word.  Files that are no longer
+//    in the tree (those removed from a snapshot's subtree, which are
+//    not freed) are pruned from the index as they are found.  After
+//    a restore or load, or moving a directory, which changes the
+//    paths of everything below it, the index is rebuilt on the next
+//    grep.  So grep must hold the tree's lock exclusively.
+// copy_path -
+//    Copies a file, or with recursive a directory and everything
+//    below it, to a new path, or into a directory under its own
+//    name.  Each copy is a new inode, but shares the contents of its
+//    file (see plain_file::clone), so a copy costs O(nodes) however
+//    large the files, and either side may be changed without
+//    affecting the other.  Copying over an existing file rewrites
+//    it, keeping its inode number.
+// move_path -
+//    Moves an entry to a new path, or into a directory under its own
+//    name, replacing a file there.  Only the two directory entries
+//    change, so a move costs O(1) however large the subtree.
+// copy_tree -
+//    Makes the copies for copy_path, indexing each file under the
+//    path it will have.
+// target_path -
+//    The absolute path of the entry a copy or move makes, which is
+//    below the target if that is a directory, after checking that
+//    the source is not the root and the target is not below it.
+//
+// Snapshots -
+//    Inodes are never changed once they may be shared with a
+//    snapshot, so a snapshot just records the root and starts a new
+//    epoch, which costs O(1).  Each inode records the epoch it was
+//    made in, and one from an older epoch may be part of a snapshot.
+//    Before changing the tree, commands get the inode to change
+//    through get_writable_inode, which copies every older inode on
+//    the path from the root (path copying), keeping inode numbers.
+// take_snapshot, restore_snapshot -
+//    Record the live tree under a name, or make a recorded tree
+//    live again.  Restoring frees inodes no longer reachable from
+//    the live tree or any snapshot.
+// diff_snapshot -
+//    Prints "+ path", "- path" for entries added or removed between
+//    two trees, and "M path" for files whose contents changed.  A
+//    subtree shared by both is skipped without looking inside it.
+//
+// save_image, load_image -
+//    Write the live tree to an image file, or replace the live tree
+//    with one read from an image (see image.h).  Loading maps the
+//    file and makes only the root; each directory makes inodes for
+//    its entries the first time it is used, and each file reads its
+//    text from the mapped file until it is rewritten.  Inode numbers
+//    are kept.  Saving reads every directory, so it makes the whole
+//    tree.  The journal sequence number is stored in the image, and
+//    returned by load_image.
+//
+// print_memory -
+//    Prints where the memory of the whole arena goes, the live tree
+//    and every snapshot:  inodes by type, the entries of directories
+//    and their indexes, and the text of files, counting each blob
+//    once however many files share it.  Walks every inode, so it
+//    must hold the tree's lock exclusively.
 
 class inode_state {
-   friend class inode;
    friend ostream& operator<< (ostream& out, const inode_state&);
    private:
-      void split(const std::string& s, std::vector<std::string>& sv, const char delim);
+      const string& normalize_path (string_view path,
+                                    bool ignore_last_node);
+      inode_ptr find_snapshot (const string& name) const;
+      void diff_tree (inode_ptr from, inode_ptr to, const string& path,
+                      ostream& out);
+      void collect();
+      void replace_root (inode_ptr new_root);
+      inode_ptr copy_tree (inode_ptr from, const string& path);
+      string target_path (const string& source, string_view to);
+      shared_ptr<file_tree> tree;
+      size_t seen_changes {0};
       string prompt_ {"% "};
+      string path_buffer;
    public:
-      inode_ptr root {nullptr};
       inode_ptr cwd {nullptr};
-      string pwd = "";
+      string pwd = "/";
+      string here_path;
+      string here_end;
       inode_state (const inode_state&) = delete; // copy ctor
       inode_state& operator= (const inode_state&) = delete; // op=
       inode_state();
+      explicit inode_state (shared_ptr<file_tree> tree_);
+      const shared_ptr<file_tree>& get_tree() const { return tree; }
+      inode_ptr get_root() const { return tree->root; }
+      void refresh();
       directory_ptr get_cur_dir();
-      inode_ptr get_inode_from_path(const string& path, bool ignore_last_node);
-      string get_name_from_path(const string& path);
-      directory_ptr get_dir_from_path(const string& path);
-      void update_pwd(const string& path);
+      inode_ptr get_inode_from_path(string_view path, bool ignore_last_node);
+      inode_ptr get_writable_inode(string_view path, bool ignore_last_node);
+      string_view get_name_from_path(string_view path);
+      directory_ptr get_dir_from_path(string_view path);
+      void update_pwd(string_view path);
       void update_prompt(const string& prompt);
       const string& prompt() const;
+      const string& session_prompt() const { return prompt_; }
+      void forget_path (string_view path, bool subtree = true);
+      void reclaim (inode_ptr node);
+      subtree_totals totals_of (inode_ptr node);
+      void update_totals (string_view path, const subtree_totals& before,
+                          const subtree_totals& after);
+      string full_path (string_view path);
+      void index_file (inode_ptr file, string_view path);
+      void unindex_file (inode_ptr file) { tree->unindex_file (file); }
+      void index_appended (inode_ptr file, word_range words);
+      void grep (const string& word, string_view path, ostream& out);
+      wordvec glob (const string& pattern);
+      void copy_path (string_view from, string_view to, bool recursive);
+      void move_path (string_view from, string_view to);
+      void take_snapshot (const string& name);
+      void restore_snapshot (const string& name);
+      void diff_snapshot (const string& from, const string& to,
+                          ostream& out);
+      void list_snapshots (ostream& out) const;
+      void save_image (const string& filename, uint64_t sequence = 0);
+      uint64_t load_image (const string& filename);
+      void print_dentry_stats (ostream& out) const;
+      void print_inode_stats (ostream& out) const;
+      void print_memory (ostream& out);
 };
 
 // class inode -
 // inode ctor -
-//    Create a new inode of the given type.
+//    Create a new inode of the given type, or a copy of another
+//    inode with the same inode number.  Only called by
+//    arena<inode>::make, which passes the new inode's own handle.
 // get_inode_nr -
 //    Retrieves the serial number of the inode.  Inode numbers are
 //    allocated in sequence by small integer.
@@ -65,9 +297,16 @@ class inode_state {
 //    number of dirents.  For a text file, the number of characters
 //    when printed (the sum of the lengths of each word, plus the
 //    number of words.
+// epoch -
+//    The snapshot epoch in which this inode was made.  See
+//    inode_state.
+//    An inode does not record its path, since a move changes the
+//    paths of everything below it, and one shared with a snapshot
+//    may be at different paths in each tree.
 //    
 
 class inode {
+   friend class file_tree;
    friend class inode_state;
    private:
       static int next_inode_nr;
@@ -75,13 +314,14 @@ class inode {
       base_file_ptr contents;
    public:
       file_type f_type;
-      string path;
-      inode (file_type, inode_ptr parent, string full_path);
+      unsigned epoch;
+      inode (inode_ptr self, file_type, unsigned new_epoch);
+      inode (inode_ptr self, file_type, unsigned new_epoch, int nr);
+      inode (inode_ptr self, const inode& that, unsigned new_epoch);
       ~inode();
       int get_inode_nr() const;
       size_t size();
       file_type get_file_type();
-      inode_ptr get_ptr();
       directory_ptr get_dir();
       plain_file_ptr get_file();
 };
@@ -106,68 +346,148 @@ class base_file {
       base_file (const base_file&) = delete;
       base_file& operator= (const base_file&) = delete;
       virtual size_t size() const = 0;
-      virtual const wordvec& readfile() const;
-      virtual void writefile (const wordvec& newdata);
-      virtual void remove (const string& filename, bool recursive);
+      virtual base_file_ptr clone (inode_ptr self) const = 0;
+      virtual string_view readfile() const;
+      virtual void writefile (word_range newdata);
+      virtual void appendfile (word_range newdata);
+      virtual inode_ptr remove (string_view filename, bool recursive);
       virtual inode_ptr mkdir (const string& dirname);
-      virtual inode_ptr mkfile (const string& filename, const wordvec& newdata);
+      virtual inode_ptr mkfile (const string& filename, word_range newdata);
 };
 
 // class plain_file -
-// Used to hold data.
+// Used to hold data.  The words are kept in a blob (see blobs.h),
+// one contiguous buffer with the words separated by single spaces,
+// exactly as cat prints them, with the offset of the start of each
+// word alongside.  Files with the same contents share one blob.
 // synthesized default ctor -
-//    Default vector<string> is a an empty vector.
+//    An empty file holding no words.
+// size -
+//    The length of the buffer, so it costs nothing to compute.
+// clone -
+//    Shares the blob, so it costs O(1) however large the file.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns a view of the buffer, valid until the next writefile.
 // writefile -
-//    Replaces the contents of a file with new contents.
+//    Replaces the contents of a file with the blob for the new
+//    contents, which is only made if no file has them already.
+// appendfile -
+//    Adds words to the end of the file (see blob_store::append),
+//    without rewriting the words already there.
+// word_count, word -
+//    The number of words and the i-th word, without copying.  The
+//    word offsets of a file mapped from an image are found the
+//    first time they are needed.
+// map -
+//    Uses text in a loaded image as the contents, without copying,
+//    until the next writefile.
+// held -
+//    The blob holding the text, or nullptr if it is mapped or empty.
 
 class plain_file: public base_file {
    private:
-      wordvec data;
+      blob_ptr contents;
+      shared_ptr<const image> source;
+      string_view mapped;
+      mutable vector<size_t> word_starts;
+      mutable bool words_indexed {true};
+      string_view text() const;
+      void index_words() const;
+      const vector<size_t>& starts() const;
       virtual const string error_file_type() const override {
          return "plain file";
       }
    public:
+      void map (shared_ptr<const image> image_, string_view text_);
+      const blob* held() const { return contents.get(); }
       virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
+      virtual base_file_ptr clone (inode_ptr self) const override;
+      virtual string_view readfile() const override;
+      virtual void writefile (word_range newdata) override;
+      virtual void appendfile (word_range newdata) override;
+      size_t word_count() const;
+      string_view word (size_t index) const;
 };
 
 // class directory -
-// Used to map filenames onto inode pointers.
-// default ctor -
-//    Creates a new map with keys "." and "..".
+// Used to map filenames onto inode pointers.  The entries are kept
+// in a dirent_index, which hashes for lookup and sorts lazily, so
+// that ls still prints in lexicographic order.
+// Dot (.) and dotdot (..) are not stored, since a directory may be
+// shared by several snapshots with different parents, but they
+// are still counted by size and listed by ls.  Paths are resolved
+// lexically by inode_state, so lookups never need them.
+// ctor -
+//    Creates a new empty directory, given its own inode.
+// ls -
+//    Lists the directory, given its path and its parent for dotdot
+//    (..).  The parent of / is / itself.  A recursive listing is made in
+//    parallel, one task per directory, each formatting into its own
+//    buffer, and the buffers are printed in the order of a depth
+//    first traversal, so the output is the same as a sequential one.
+// get_totals -
+//    The subtree totals (see dirents.h), which include the directory
+//    itself, kept up to date by inode_state::update_totals.
+// map -
+//    Takes the entries from a directory in a loaded image.  Inodes
+//    for them are made by materialize the first time the entries
+//    are used, through entries().  Until then, dirents is empty.
+//    Sessions may read a directory at the same time, so the inodes
+//    are made under map_lock, once.
 // remove -
-//    Removes the file or subdirectory from the current inode.
+//    Removes the file or subdirectory from the current inode, and
+//    returns its inode, which is no longer reachable and should be
+//    passed to inode_state::reclaim.  This takes O(1) time however
+//    large the subdirectory is.
 //    Throws an file_error if this is not a directory, the file
 //    does not exist, or the subdirectory is not empty.
-//    Here empty means the only entries are dot (.) and dotdot (..).
 // mkdir -
-//    Creates a new directory under the current directory and 
-//    immediately adds the directories dot (.) and dotdot (..) to it.
-//    Note that the parent (..) of / is / itself.  It is an error
-//    if the entry already exists.
+//    Creates a new directory under the current directory.  It is
+//    an error if the entry already exists.
 // mkfile -
 //    Create a new empty text file with the given name.  Error if
 //    a dirent with that name exists.
+// link -
+//    Enters an inode made or removed elsewhere under a name, and
+//    returns the inode the name named before, or nullptr.
 
 class directory: public base_file {
+   friend class file_tree;
    friend class inode;
    friend class inode_state;
+   friend class reclaimer;
    private:
-      // Must be a map, not unordered_map, so printing is lexicographic
-      map<string,inode_ptr> dirents;
+      struct listing;
+      inode_ptr self;
+      dirent_index dirents;
+      subtree_totals totals;
+      shared_ptr<const image> source;
+      uint64_t source_index {0};
+      atomic<bool> mapped {false};
+      mutable mutex map_lock;
+      directory(inode_ptr self_, const directory& that);
+      void materialize();
+      dirent_index& entries();
+      void format (string& out, const string& path, inode_ptr parent,
+                   const vector<const dirent*>& sorted) const;
+      static void list_tree (work_pool& pool, inode_ptr node,
+                             string path, inode_ptr parent,
+                             listing& into);
       virtual const string error_file_type() const override {
          return "directory";
       }
    public:
-      directory(inode_ptr curr, inode_ptr parent);
-      void ls(bool recursive);
+      explicit directory(inode_ptr self_);
+      const subtree_totals& get_totals() const { return totals; }
+      void map (shared_ptr<const image> image_, uint64_t index);
+      void ls(ostream& out, const string& path, inode_ptr parent,
+              bool recursive);
+      inode_ptr link (const string& name, inode_ptr node);
       virtual size_t size() const override;
-      virtual void remove (const string& filename, bool recursive) override;
+      virtual base_file_ptr clone (inode_ptr self_) const override;
+      virtual inode_ptr remove (string_view filename, bool recursive) override;
       virtual inode_ptr mkdir (const string& dirname) override;
-      virtual inode_ptr mkfile (const string& filename, const wordvec& newdata) override;
+      virtual inode_ptr mkfile (const string& filename, word_range newdata) override;
 };
 
 #endif
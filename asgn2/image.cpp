@@ -0,0 +1,179 @@
+// $Id: image.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "file_sys.h"
+#include "image.h"
+
+const char image::MAGIC[8] {'Y', 'S', 'H', 'I', 'M', 'A', 'G', 'E'};
+
+void image_builder::add_directory (uint32_t inode_nr, uint64_t first,
+                                   uint64_t count) {
+   inodes.push_back ({inode_nr, 1, first, count});
+   if (inode_nr > max_inode_nr) max_inode_nr = inode_nr;
+}
+
+void image_builder::add_file (uint32_t inode_nr, string_view text) {
+   inodes.push_back ({inode_nr, 0, content.size(), text.size()});
+   content.append (text);
+   if (inode_nr > max_inode_nr) max_inode_nr = inode_nr;
+}
+
+void image_builder::add_dirent (string_view name, uint32_t inode_index) {
+   dirents.push_back ({strings.size(),
+                       static_cast<uint32_t> (name.size()), inode_index});
+   strings.append (name);
+}
+
+template <typename item_t>
+static void write_table (ofstream& out, const vector<item_t>& table) {
+   out.write (reinterpret_cast<const char*> (table.data()),
+              table.size() * sizeof (item_t));
+}
+
+void image_builder::write (const string& filename,
+                           uint64_t sequence) const {
+   ofstream out (filename, ios::binary | ios::trunc);
+   if (not out) throw file_error (filename + ": " + strerror (errno));
+   disk_header header {};
+   memcpy (header.magic, image::MAGIC, sizeof header.magic);
+   header.version = image::VERSION;
+   header.max_inode_nr = max_inode_nr;
+   header.sequence = sequence;
+   header.inode_count = inodes.size();
+   header.dirent_count = dirents.size();
+   header.string_bytes = strings.size();
+   header.content_bytes = content.size();
+   out.write (reinterpret_cast<const char*> (&header), sizeof header);
+   write_table (out, inodes);
+   write_table (out, dirents);
+   out.write (strings.data(), strings.size());
+   out.write (content.data(), content.size());
+   out.close();
+   if (out.fail()) throw file_error (filename + ": write failed");
+   DEBUGF ('m', filename << ": " << inodes.size() << " inodes, "
+           << dirents.size() << " dirents");
+}
+
+shared_ptr<const image> image::open (const string& filename) {
+   int fd = ::open (filename.c_str(), O_RDONLY);
+   if (fd < 0) throw file_error (filename + ": " + strerror (errno));
+   struct stat status;
+   if (fstat (fd, &status) < 0) {
+      int error = errno;
+      close (fd);
+      throw file_error (filename + ": " + strerror (error));
+   }
+   shared_ptr<image> result (new image());
+   result->length = status.st_size;
+   if (result->length < sizeof (disk_header)) {
+      close (fd);
+      throw file_error (filename + ": not a yshell image");
+   }
+   void* mapped = mmap (nullptr, result->length, PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+   close (fd);
+   if (mapped == MAP_FAILED) {
+      throw file_error (filename + ": " + strerror (errno));
+   }
+   result->base = static_cast<const char*> (mapped);
+   result->header = reinterpret_cast<const disk_header*> (result->base);
+   const disk_header& header = *result->header;
+   if (memcmp (header.magic, MAGIC, sizeof MAGIC) != 0
+       or header.version != VERSION) {
+      throw file_error (filename + ": not a yshell image");
+   }
+   // Check the table sizes without overflow before adding them up.
+   uint64_t space = result->length - sizeof header;
+   uint64_t inode_bytes = header.inode_count * sizeof (disk_inode);
+   uint64_t dirent_bytes = header.dirent_count * sizeof (disk_dirent);
+   if (header.inode_count == 0
+       or header.inode_count > space / sizeof (disk_inode)
+       or header.dirent_count > space / sizeof (disk_dirent)
+       or header.string_bytes > space or header.content_bytes > space
+       or inode_bytes + dirent_bytes + header.string_bytes
+          + header.content_bytes != space) {
+      throw file_error (filename + ": image is truncated or corrupt");
+   }
+   const char* table = result->base + sizeof header;
+   result->inodes = reinterpret_cast<const disk_inode*> (table);
+   table += inode_bytes;
+   result->dirents = reinterpret_cast<const disk_dirent*> (table);
+   table += dirent_bytes;
+   result->strings = table;
+   result->content = table + header.string_bytes;
+   result->sum_totals();
+   DEBUGF ('m', filename << ": " << header.inode_count << " inodes, "
+           << result->length << " bytes");
+   return result;
+}
+
+void image::sum_totals() {
+   totals.resize (header->inode_count);
+   for (uint64_t index = header->inode_count; index-- > 0; ) {
+      const disk_inode& node = inode_at (index);
+      subtree_totals& sum = totals[index];
+      if (not node.is_directory) {
+         sum.bytes = node.count;
+         sum.files = 1;
+         continue;
+      }
+      sum.directories = 1;
+      for (uint64_t entry = 0; entry < node.count; ++entry) {
+         uint64_t child = dirent_at (node.first + entry).inode_index;
+         if (child <= index) throw file_error ("image: bad dirent order");
+         sum += totals[child];
+      }
+   }
+}
+
+image::~image() {
+   if (base != nullptr) {
+      munmap (const_cast<char*> (base), length);
+   }
+}
+
+const disk_inode& image::inode_at (uint64_t index) const {
+   if (index >= header->inode_count) {
+      throw file_error ("image: bad inode index");
+   }
+   const disk_inode& node = inodes[index];
+   uint64_t limit = node.is_directory ? header->dirent_count
+                                      : header->content_bytes;
+   if (node.first > limit or node.count > limit - node.first) {
+      throw file_error ("image: bad inode");
+   }
+   return node;
+}
+
+const disk_dirent& image::dirent_at (uint64_t index) const {
+   if (index >= header->dirent_count) {
+      throw file_error ("image: bad dirent index");
+   }
+   const disk_dirent& entry = dirents[index];
+   if (entry.name_offset > header->string_bytes
+       or entry.name_length > header->string_bytes - entry.name_offset
+       or entry.inode_index >= header->inode_count) {
+      throw file_error ("image: bad dirent");
+   }
+   return entry;
+}
+
+string_view image::name (const disk_dirent& entry) const {
+   return string_view (strings + entry.name_offset, entry.name_length);
+}
+
+string_view image::text (const disk_inode& node) const {
+   return string_view (content + node.first, node.count);
+}
+
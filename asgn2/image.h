@@ -0,0 +1,116 @@
+// $Id: image.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// image -
+//    A saved filesystem tree, in a compact file that is read with
+//    mmap so that loading costs nothing until the inodes are used.
+//    The file has a header followed by four tables:
+//       inode table:   one disk_inode per inode, the root first.
+//       dirent table:  the entries of each directory, contiguous
+//                      and sorted by name.
+//       string table:  the entry names, without terminators.
+//       content blob:  the text of each file, as cat prints it.
+//    Numbers are stored in the byte order of the machine, so an
+//    image can only be loaded where it was saved.  The header also
+//    holds the sequence number of the last journal record included
+//    in the image, or 0.
+//
+// image_builder -
+//    Accumulates the tables in memory and writes the file.  The
+//    caller adds inodes in index order; each directory gives the
+//    index of its first entry and the number of entries.
+//
+// image::open -
+//    Maps a file read-only and checks the header.  Records are
+//    checked as they are read, and a bad one throws file_error.
+//    The subtree totals of every directory are computed from the
+//    tables in one pass from the last inode back to the root, which
+//    works because every entry has a higher index than its
+//    directory.  They are not stored in the file.
+//
+
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "dirents.h"
+
+struct disk_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t max_inode_nr;
+   uint64_t sequence;
+   uint64_t inode_count;
+   uint64_t dirent_count;
+   uint64_t string_bytes;
+   uint64_t content_bytes;
+};
+
+struct disk_inode {
+   uint32_t inode_nr;
+   uint32_t is_directory;
+   uint64_t first;   // first dirent, or offset into the content blob
+   uint64_t count;   // number of dirents, or bytes of content
+};
+
+struct disk_dirent {
+   uint64_t name_offset;
+   uint32_t name_length;
+   uint32_t inode_index;
+};
+
+class image_builder {
+   private:
+      vector<disk_inode> inodes;
+      vector<disk_dirent> dirents;
+      string strings;
+      string content;
+      uint32_t max_inode_nr {0};
+   public:
+      void add_directory (uint32_t inode_nr, uint64_t first,
+                          uint64_t count);
+      void add_file (uint32_t inode_nr, string_view text);
+      void add_dirent (string_view name, uint32_t inode_index);
+      size_t dirent_count() const { return dirents.size(); }
+      void write (const string& filename, uint64_t sequence) const;
+};
+
+class image {
+   private:
+      const char* base {nullptr};
+      size_t length {0};
+      const disk_header* header {nullptr};
+      const disk_inode* inodes {nullptr};
+      const disk_dirent* dirents {nullptr};
+      const char* strings {nullptr};
+      const char* content {nullptr};
+      vector<subtree_totals> totals;
+      image() = default;
+      void sum_totals();
+   public:
+      static const char MAGIC[8];
+      static constexpr uint32_t VERSION = 2;
+      static shared_ptr<const image> open (const string& filename);
+      ~image();
+      image (const image&) = delete;
+      image& operator= (const image&) = delete;
+      uint64_t inode_count() const { return header->inode_count; }
+      uint32_t max_inode_nr() const { return header->max_inode_nr; }
+      uint64_t sequence() const { return header->sequence; }
+      const disk_inode& inode_at (uint64_t index) const;
+      const disk_dirent& dirent_at (uint64_t index) const;
+      string_view name (const disk_dirent&) const;
+      string_view text (const disk_inode&) const;
+      const subtree_totals& totals_at (uint64_t index) const {
+         return totals.at (index);
+      }
+};
+
+#endif
+
@@ -0,0 +1,207 @@
+// $Id: journal.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstring>
+#include <unordered_set>
+using namespace std;
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "commands.h"
+#include "debug.h"
+#include "journal.h"
+
+// Commands that change the state and are logged.
+static const unordered_set<string> logged_commands {
+   "append", "cd", "cp", "make", "mkdir", "mv", "prompt", "rm",
+   "rmr",
+};
+
+// Commands that replace the whole tree, which is checkpointed
+// instead of logged.
+static const unordered_set<string> checkpoint_commands {
+   "load", "restore",
+};
+
+static uint32_t fnv1a (string_view bytes) {
+   uint32_t hash = 2166136261u;
+   for (unsigned char byte: bytes) {
+      hash ^= byte;
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+template <typename number_t>
+static void put_number (string& buffer, number_t number) {
+   buffer.append (reinterpret_cast<const char*> (&number), sizeof number);
+}
+
+template <typename number_t>
+static number_t get_number (string_view buffer, size_t offset) {
+   number_t number;
+   memcpy (&number, buffer.data() + offset, sizeof number);
+   return number;
+}
+
+static file_error errno_error (const string& filename) {
+   return file_error (filename + ": " + strerror (errno));
+}
+
+// sync_file -
+//    Flushes a file, or a directory, to disk.
+static void sync_file (const string& filename) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) throw errno_error (filename);
+   int status = fsync (fd);
+   close (fd);
+   if (status < 0) throw errno_error (filename);
+}
+
+journal::journal (const string& filename_):
+         filename (filename_), image_name (filename_ + ".img") {
+   fd = open (filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0666);
+   if (fd < 0) throw errno_error (filename);
+}
+
+journal::~journal() {
+   try {
+      commit();
+   }catch (file_error& error) {
+      complain() << error.what() << endl;
+   }
+   close (fd);
+}
+
+void journal::recover (inode_state& state) {
+   if (access (image_name.c_str(), F_OK) == 0) {
+      sequence = state.load_image (image_name);
+   }
+   uint64_t checkpoint_sequence = sequence;
+   string contents;
+   char block[65536];
+   for (off_t offset = 0;;) {
+      ssize_t count = pread (fd, block, sizeof block, offset);
+      if (count < 0) throw errno_error (filename);
+      if (count == 0) break;
+      contents.append (block, count);
+      offset += count;
+   }
+   string_view rest = contents;
+   for (;;) {
+      if (rest.size() < 8) break;
+      uint32_t length = get_number<uint32_t> (rest, 0);
+      if (length < 12 or length > rest.size() - 8) break;
+      string_view body = rest.substr (8, length);
+      if (fnv1a (body) != get_number<uint32_t> (rest, 4)) break;
+      uint64_t record_sequence = get_number<uint64_t> (body, 0);
+      uint32_t word_count = get_number<uint32_t> (body, 8);
+      wordvec words;
+      size_t position = 12;
+      for (; words.size() < word_count; ) {
+         if (body.size() - position < 4) break;
+         uint32_t word_length = get_number<uint32_t> (body, position);
+         position += 4;
+         if (body.size() - position < word_length) break;
+         words.emplace_back (body.substr (position, word_length));
+         position += word_length;
+      }
+      if (words.size() != word_count or words.empty()) break;
+      rest.remove_prefix (8 + length);
+      if (record_sequence <= sequence) continue;
+      sequence = record_sequence;
+      ++since_checkpoint;
+      ++replayed;
+      DEBUGF ('j', "replay " << sequence << ": " << words);
+      try {
+         run_command (state, words);
+      }catch (command_error& error) {
+         DEBUGF ('j', "replay failed: " << error.what());
+      }
+   }
+   if (not rest.empty()) {
+      // A crash while writing leaves a partial record at the end.
+      off_t good = contents.size() - rest.size();
+      cerr << exec::execname() << ": " << filename << ": discarding "
+           << rest.size() << " bytes of incomplete journal" << endl;
+      if (ftruncate (fd, good) < 0) throw errno_error (filename);
+   }
+   DEBUGF ('j', "checkpoint " << checkpoint_sequence << ", replayed "
+           << replayed << ", sequence " << sequence);
+}
+
+void journal::append (const wordvec& words) {
+   string body;
+   put_number<uint64_t> (body, ++sequence);
+   put_number<uint32_t> (body, words.size());
+   for (const string& word: words) {
+      put_number<uint32_t> (body, word.size());
+      body += word;
+   }
+   put_number<uint32_t> (pending, body.size());
+   put_number<uint32_t> (pending, fnv1a (body));
+   pending += body;
+   ++pending_records;
+   ++records;
+   ++since_checkpoint;
+}
+
+void journal::log (inode_state& state, const wordvec& words) {
+   if (checkpoint_commands.count (words[0]) > 0) {
+      checkpoint (state);
+      return;
+   }
+   if (logged_commands.count (words[0]) == 0) return;
+   append (words);
+   if (pending_records >= GROUP_RECORDS) commit();
+   if (since_checkpoint >= CHECKPOINT_RECORDS) checkpoint (state);
+}
+
+void journal::commit() {
+   if (pending.empty()) return;
+   for (size_t written = 0; written < pending.size(); ) {
+      ssize_t count = write (fd, pending.data() + written,
+                             pending.size() - written);
+      if (count < 0) throw errno_error (filename);
+      written += count;
+   }
+   if (fdatasync (fd) < 0) throw errno_error (filename);
+   DEBUGF ('j', "commit " << pending_records << " records");
+   pending.clear();
+   pending_records = 0;
+   ++commits;
+}
+
+void journal::checkpoint (inode_state& state) {
+   commit();
+   // The image must be on disk under its final name before the
+   // journal records it replaces are thrown away.
+   string temp = image_name + ".tmp";
+   state.save_image (temp, sequence);
+   sync_file (temp);
+   if (rename (temp.c_str(), image_name.c_str()) < 0) {
+      throw errno_error (image_name);
+   }
+   size_t slash = image_name.find_last_of ('/');
+   sync_file (slash == string::npos ? "."
+                                    : image_name.substr (0, slash + 1));
+   if (ftruncate (fd, 0) < 0) throw errno_error (filename);
+   since_checkpoint = 0;
+   ++checkpoints;
+   DEBUGF ('j', "checkpoint " << sequence);
+   append ({"cd", state.pwd});
+   // Not prompt(), which is "> " while a here document is open.
+   wordvec prompt = split (state.session_prompt(), " ");
+   prompt.insert (prompt.begin(), "prompt");
+   append (prompt);
+   commit();
+}
+
+void journal::print_stats (ostream& out) const {
+   out << "journal: " << records << " records, " << commits
+       << " commits, " << checkpoints << " checkpoints, " << replayed
+       << " replayed" << endl;
+}
+
@@ -0,0 +1,78 @@
+// $Id: journal.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// journal -
+//    A write-ahead log of the commands that change the state, so a
+//    session survives a crash.  Each command that succeeds and is
+//    logged, or the part of one that was done before it failed (see
+//    command_error), is appended as one binary record:
+//       uint32 length     of the rest of the record
+//       uint32 checksum   FNV-1a of the rest of the record
+//       uint64 sequence   numbered from 1 for the whole journal
+//       uint32 count      of words, then for each word,
+//       uint32 length     and the bytes of the word.
+//    Records are collected in memory and written with one write and
+//    one fdatasync (group commit) when GROUP_RECORDS are waiting, and
+//    whenever the shell is about to wait for input.
+//
+//    Every CHECKPOINT_RECORDS records, and after commands that
+//    replace the whole tree, the tree is saved to an image next to
+//    the journal (name.img), which records the last sequence number
+//    it includes, and the journal is truncated.  Since an image has
+//    no cwd or prompt, cd and prompt records are then written again.
+//    So recovery loads the image and replays only the records after
+//    it, and takes time bounded by the journal tail.
+//
+// recover -
+//    Loads the checkpoint, if any, and replays the journal through
+//    the command functions, skipping records already in the image.
+//    A torn or corrupt record ends the journal, and is cut off.
+// log -
+//    Called after each command succeeds, or with what was applied of
+//    one that failed.  Appends the command if it is logged, and
+//    commits or checkpoints as needed.
+// commit -
+//    Writes and syncs waiting records.
+//
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+class journal {
+   private:
+      string filename;
+      string image_name;
+      int fd {-1};
+      string pending;
+      size_t pending_records {0};
+      uint64_t sequence {0};
+      size_t since_checkpoint {0};
+      size_t records {0};
+      size_t commits {0};
+      size_t checkpoints {0};
+      size_t replayed {0};
+      void append (const wordvec& words);
+      void checkpoint (inode_state& state);
+   public:
+      static constexpr size_t GROUP_RECORDS = 64;
+      static constexpr size_t CHECKPOINT_RECORDS = 4096;
+      explicit journal (const string& filename_);
+      ~journal();
+      journal (const journal&) = delete;
+      journal& operator= (const journal&) = delete;
+      void recover (inode_state& state);
+      void log (inode_state& state, const wordvec& words);
+      void commit();
+      void print_stats (ostream& out) const;
+};
+
+#endif
+
@@ -2,37 +2,74 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
+#include <poll.h>
 #include <unistd.h>
 
 using namespace std;
 
+#include "batch.h"
 #include "commands.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "journal.h"
+#include "server.h"
 #include "util.h"
 
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:
+//    -@flags    turns on debug flags.
+//    -b         batch mode:  reads commands from stdin without a
+//               prompt or echo, and buffers all output (batch.h).
+//    -j journal keeps a write-ahead journal of the session in the
+//               named file, with its checkpoint in journal.img, and
+//               recovers from them at startup.
+//    -s socket  server mode:  serves sessions on the tree to clients
+//               of the named Unix domain socket (server.h) instead
+//               of reading commands, until SIGINT or SIGTERM.
+//    An operand names a script to run in batch mode instead of
+//    reading stdin.
+
+string journal_name;
+string script_name;
+string socket_name;
+
+// input_ready -
+//    True if the next read of stdin will not block.
+bool input_ready() {
+   pollfd input {STDIN_FILENO, POLLIN, 0};
+   return poll (&input, 1, 0) > 0;
+}
 
 void scan_options (int argc, char** argv) {
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:bj:s:");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'b':
+            script_name = "-";
+            break;
+         case 'j':
+            journal_name = optarg;
+            break;
+         case 's':
+            socket_name = optarg;
+            break;
          default:
             complain() << "-" << static_cast<char> (option)
                        << ": invalid option" << endl;
             break;
       }
    }
+   if (optind < argc) script_name = argv[optind++];
    if (optind < argc) {
-      complain() << "operands not permitted" << endl;
+      complain() << "only one script permitted" << endl;
    }
 }
 
@@ -46,39 +83,108 @@ int main (int argc, char** argv) {
    cerr << boolalpha;
    cout << argv[0] << " build " << __DATE__ << " " << __TIME__ << endl;
    scan_options (argc, argv);
+   if (not socket_name.empty()) {
+      // The journal replays every session's commands as one.
+      if (not journal_name.empty() or not script_name.empty()) {
+         complain() << "-s may not be used with -j or a script" << endl;
+         return exit_status_message();
+      }
+      shell_server::block_signals();
+   }
    bool need_echo = want_echo();
+   unique_ptr<script_reader> script;
+   if (not script_name.empty()) {
+      try {
+         script = make_unique<script_reader> (script_name);
+      }catch (file_error& error) {
+         complain() << error.what() << endl;
+         return exit_status_message();
+      }
+   }
+   batch_output batch_out (STDOUT_FILENO);
+   streambuf* interactive_out = cout.rdbuf();
+   if (script) cout.rdbuf (&batch_out);
    inode_state state;
-   try {
-      for (;;) {
-         try {
-            // Read a line, break at EOF, and echo print the prompt
-            // if one is needed.
-            cout << state.prompt();
-            string line;
-            getline (cin, line);
-            if (cin.eof()) {
-               if (need_echo) cout << "^D";
-               cout << endl;
-               DEBUGF ('y', "EOF");
-               break;
+   unique_ptr<journal> wal;
+   if (not journal_name.empty()) {
+      try {
+         wal = make_unique<journal> (journal_name);
+         wal->recover (state);
+      }catch (file_error& error) {
+         complain() << error.what() << endl;
+         return exit_status_message();
+      }
+   }
+   if (not socket_name.empty()) {
+      try {
+         shell_server server (socket_name, state.get_tree());
+         server.run();
+         DEBUGS ('a', server.print_stats (cerr));
+      }catch (file_error& error) {
+         complain() << error.what() << endl;
+      }
+   }else {
+      try {
+         for (;;) {
+            try {
+               // Commit the journal before waiting for more input, so
+               // that a script's commands are committed in groups.
+               if (wal and not script and not input_ready()) wal->commit();
+
+               // Read a line, break at EOF, and echo print the prompt
+               // if one is needed.
+               string line;
+               if (script) {
+                  if (not script->getline (line)) break;
+               }else {
+                  cout << state.prompt();
+                  getline (cin, line);
+                  if (cin.eof()) {
+                     if (need_echo) cout << "^D";
+                     cout << endl;
+                     DEBUGF ('y', "EOF");
+                     break;
+                  }
+                  if (need_echo) cout << line << endl;
+               }
+
+               // Split the line into words and lookup the appropriate
+               // function.  Complain or call it.
+               wordvec words = split (line, " \t");
+               DEBUGF ('y', "words = " << words);
+               words = run_line (state, words);
+               if (wal and not words.empty()) wal->log (state, words);
+            }catch (command_error& error) {
+               // If there is a problem discovered in any function, an
+               // exn is thrown and printed here.  Whatever it did
+               // before failing must still be journaled.
+               if (wal and not error.applied.empty()) {
+                  wal->log (state, error.applied);
+               }
+               // Errors are not buffered, so write the output before
+               // them first, to keep them in order.
+               if (script) batch_out.flush();
+               complain() << error.what() << endl;
+            }catch (file_error& error) {
+               // Bad image files are found when they are read.
+               if (script) batch_out.flush();
+               complain() << error.what() << endl;
             }
-            if (need_echo) cout << line << endl;
-   
-            // Split the line into words and lookup the appropriate
-            // function.  Complain or call it.
-            wordvec words = split (line, " \t");
-            if(words.at(0)[0] == '#') continue;
-            DEBUGF ('y', "words = " << words);
-            command_fn fn = find_command_fn (words.at(0));
-            fn (state, words);
-         }catch (command_error& error) {
-            // If there is a problem discovered in any function, an
-            // exn is thrown and printed here.
-            complain() << error.what() << endl;
          }
+      } catch (ysh_exit&) {
+         // This catch intentionally left blank.
       }
-   } catch (ysh_exit&) {
-      // This catch intentionally left blank.
+   }
+   if (script) {
+      batch_out.flush();
+      cout.rdbuf (interactive_out);
+   }
+   DEBUGS ('d', state.print_dentry_stats (cerr));
+   DEBUGS ('a', state.print_inode_stats (cerr));
+   DEBUGS ('a', call_stats.print (cerr));
+   if (wal) {
+      DEBUGS ('j', wal->print_stats (cerr));
+      wal.reset();
    }
 
    return exit_status_message();
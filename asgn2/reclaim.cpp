@@ -0,0 +1,88 @@
+// $Id: reclaim.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include "debug.h"
+#include "file_sys.h"
+#include "reclaim.h"
+
+reclaimer::reclaimer (arena<inode>& inodes_,
+                      function<void(inode_ptr)> before_free_):
+           inodes (inodes_), before_free (before_free_),
+           worker (&reclaimer::work, this) {
+}
+
+reclaimer::~reclaimer() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   changed.notify_all();
+   worker.join();
+}
+
+void reclaimer::detach (inode_ptr node, unsigned epoch) {
+   {
+      lock_guard<mutex> guard (lock);
+      queue.emplace_back (node, epoch);
+      ++subtrees_queued;
+   }
+   changed.notify_all();
+}
+
+void reclaimer::drain() {
+   unique_lock<mutex> guard (lock);
+   changed.wait (guard, [this] {
+      return stopping or subtrees_done == subtrees_queued;
+   });
+}
+
+void reclaimer::work() {
+   unique_lock<mutex> guard (lock);
+   for (;;) {
+      changed.wait (guard, [this] {
+         return stopping or not queue.empty();
+      });
+      if (stopping) return;
+      auto [node, epoch] = queue.front();
+      queue.pop_front();
+      guard.unlock();
+      vector<inode_ptr> pending {node};
+      while (not pending.empty() and not stopping) {
+         free_batch (pending, epoch);
+      }
+      guard.lock();
+      ++subtrees_done;
+      changed.notify_all();
+   }
+}
+
+// free_batch -
+//    Frees up to BATCH inodes from the subtree.  Each directory's
+//    entries are pushed before the directory itself is freed.
+void reclaimer::free_batch (vector<inode_ptr>& pending, unsigned epoch) {
+   size_t count = 0;
+   size_t bytes = 0;
+   for (; count < BATCH and not pending.empty(); ++count) {
+      inode_ptr node = pending.back();
+      pending.pop_back();
+      directory_ptr dir = node->get_dir();
+      if (dir == nullptr) {
+         bytes += node->size();
+      }else {
+         for (const dirent& entry: dir->dirents) {
+            if (entry.node->epoch == epoch) pending.push_back (entry.node);
+         }
+      }
+      before_free (node);
+      inodes.free (node);
+   }
+   inodes_freed += count;
+   bytes_freed += bytes;
+   DEBUGF ('r', "freed " << inodes_freed << " inodes, "
+           << pending.size() << " pending");
+}
+
+void reclaimer::print_stats (ostream& out) const {
+   out << "reclaimer: " << subtrees_done << " of " << subtrees_queued
+       << " subtrees, " << inodes_freed << " inodes, " << bytes_freed
+       << " file bytes freed" << endl;
+}
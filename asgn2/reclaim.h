@@ -0,0 +1,72 @@
+// $Id: reclaim.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// reclaimer -
+//    Frees removed subtrees on a background thread, so that rmr of
+//    a large tree returns as soon as the entry is unlinked.  The
+//    thread walks each subtree depth first and frees its inodes in
+//    batches of BATCH, publishing its progress after each batch.
+//    Only inodes of the epoch given with the subtree are freed, and
+//    nothing below an older one, which may be shared by a snapshot.
+//    A detached subtree must not be reachable from anywhere else.
+// ctor -
+//    Takes the arena and a function to call, on the reclaimer's
+//    thread, with each inode just before it is freed.
+// detach -
+//    Queues a subtree to be freed, and returns at once.
+// drain -
+//    Waits until everything queued has been freed.  Must be called
+//    before walking the whole arena.
+// dtor -
+//    Stops the thread after its current batch.  Whatever is left is
+//    freed with the arena.
+//
+
+#ifndef __RECLAIM_H__
+#define __RECLAIM_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "arena.h"
+
+class inode;
+using inode_ptr = handle<inode>;
+
+class reclaimer {
+   private:
+      arena<inode>& inodes;
+      function<void(inode_ptr)> before_free;
+      mutex lock;
+      condition_variable changed;
+      deque<pair<inode_ptr,unsigned>> queue;
+      atomic<bool> stopping {false};
+      atomic<size_t> subtrees_queued {0};
+      atomic<size_t> subtrees_done {0};
+      atomic<size_t> inodes_freed {0};
+      atomic<size_t> bytes_freed {0};
+      thread worker;
+      void work();
+      void free_batch (vector<inode_ptr>& pending, unsigned epoch);
+   public:
+      static constexpr size_t BATCH = 4096;
+      reclaimer (arena<inode>& inodes_,
+                 function<void(inode_ptr)> before_free_);
+      ~reclaimer();
+      reclaimer (const reclaimer&) = delete;
+      reclaimer& operator= (const reclaimer&) = delete;
+      void detach (inode_ptr node, unsigned epoch);
+      void drain();
+      void print_stats (ostream& out) const;
+};
+
+#endif
+
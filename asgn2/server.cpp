@@ -0,0 +1,307 @@
+// $Id: server.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+using namespace std;
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "commands.h"
+#include "debug.h"
+#include "server.h"
+
+static file_error errno_error (const string& what) {
+   return file_error (what + ": " + strerror (errno));
+}
+
+// output_capture -
+//    Sends everything written to a stream to the end of a string,
+//    until it goes out of scope.
+class output_capture: public streambuf {
+   private:
+      ostream& stream;
+      string& into;
+      streambuf* saved;
+   protected:
+      int_type overflow (int_type byte) override {
+         if (not traits_type::eq_int_type (byte, traits_type::eof())) {
+            into += traits_type::to_char_type (byte);
+         }
+         return traits_type::not_eof (byte);
+      }
+      streamsize xsputn (const char* data, streamsize count) override {
+         into.append (data, count);
+         return count;
+      }
+   public:
+      output_capture (ostream& stream_, string& into_):
+                      stream (stream_), into (into_),
+                      saved (stream_.rdbuf (this)) {}
+      ~output_capture() { stream.rdbuf (saved); }
+};
+
+static sigset_t stop_signals() {
+   sigset_t signals;
+   sigemptyset (&signals);
+   sigaddset (&signals, SIGINT);
+   sigaddset (&signals, SIGTERM);
+   return signals;
+}
+
+void shell_server::block_signals() {
+   sigset_t signals = stop_signals();
+   pthread_sigmask (SIG_BLOCK, &signals, nullptr);
+}
+
+shell_server::shell_server (const string& path_,
+                            shared_ptr<file_tree> tree_):
+              path (path_), tree (tree_) {
+   epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+   if (epoll_fd < 0) throw errno_error ("epoll");
+   sigset_t signals = stop_signals();
+   signal_fd = signalfd (-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (signal_fd < 0) throw errno_error ("signalfd");
+   watch (signal_fd, EPOLLIN);
+   listen_at();
+   watch (listen_fd, EPOLLIN);
+   DEBUGF ('n', "listening on " << path);
+}
+
+shell_server::~shell_server() {
+   while (not connections.empty()) {
+      close_connection (*connections.begin()->second);
+   }
+   if (listen_fd >= 0) {
+      close (listen_fd);
+      unlink (path.c_str());
+   }
+   if (signal_fd >= 0) close (signal_fd);
+   if (epoll_fd >= 0) close (epoll_fd);
+}
+
+// listen_at -
+//    Binds the socket.  If the path is taken, but nothing accepts
+//    connections on it, it was left by a server that died, and is
+//    removed.
+void shell_server::listen_at() {
+   sockaddr_un address {};
+   address.sun_family = AF_UNIX;
+   if (path.size() >= sizeof address.sun_path) {
+      throw file_error (path + ": socket path too long");
+   }
+   strcpy (address.sun_path, path.c_str());
+   sockaddr* name = reinterpret_cast<sockaddr*> (&address);
+   listen_fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK
+                       | SOCK_CLOEXEC, 0);
+   if (listen_fd < 0) throw errno_error (path);
+   if (bind (listen_fd, name, sizeof address) < 0) {
+      if (errno != EADDRINUSE) throw errno_error (path);
+      int probe = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      bool alive = probe >= 0
+                   and connect (probe, name, sizeof address) == 0;
+      if (probe >= 0) close (probe);
+      if (alive) throw file_error (path + ": server already running");
+      unlink (path.c_str());
+      if (bind (listen_fd, name, sizeof address) < 0) {
+         throw errno_error (path);
+      }
+   }
+   if (listen (listen_fd, SOMAXCONN) < 0) throw errno_error (path);
+}
+
+void shell_server::watch (int fd, uint32_t events) {
+   epoll_event event {};
+   event.events = events;
+   event.data.fd = fd;
+   if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+      throw errno_error ("epoll");
+   }
+}
+
+void shell_server::run() {
+   constexpr int MAX_EVENTS = 64;
+   epoll_event events[MAX_EVENTS];
+   for (;;) {
+      int count = epoll_wait (epoll_fd, events, MAX_EVENTS, -1);
+      if (count < 0) {
+         if (errno == EINTR) continue;
+         throw errno_error ("epoll");
+      }
+      for (int index = 0; index < count; ++index) {
+         int fd = events[index].data.fd;
+         if (fd == signal_fd) {
+            DEBUGF ('n', "stopping");
+            return;
+         }
+         if (fd == listen_fd) {
+            accept_all();
+            continue;
+         }
+         // Closed by an earlier event in this batch.
+         auto found = connections.find (fd);
+         if (found == connections.end()) continue;
+         connection& client = *found->second;
+         if (events[index].events & EPOLLOUT) transmit (client);
+         if (not client.closing
+             and events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            receive (client);
+         }
+         update (client);
+      }
+   }
+}
+
+void shell_server::accept_all() {
+   for (;;) {
+      int fd = accept4 (listen_fd, nullptr, nullptr,
+                        SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+         if (errno == EINTR) continue;
+         if (errno != EAGAIN and errno != EWOULDBLOCK) {
+            DEBUGF ('n', "accept: " << strerror (errno));
+         }
+         return;
+      }
+      auto client = make_unique<connection> (fd, tree);
+      client->output = client->session.prompt();
+      connection& added = *client;
+      connections.emplace (fd, move (client));
+      ++accepted;
+      DEBUGF ('n', "connection " << fd);
+      update (added);
+   }
+}
+
+// receive -
+//    Reads what the client has sent, once per event, so that one
+//    busy client does not starve the rest, and runs the lines.
+void shell_server::receive (connection& client) {
+   char block[65536];
+   ssize_t count = read (client.fd, block, sizeof block);
+   if (count < 0) {
+      if (errno == EINTR or errno == EAGAIN) return;
+      DEBUGF ('n', "read " << client.fd << ": " << strerror (errno));
+      client.closing = true;
+      client.output.clear();
+      return;
+   }
+   if (count == 0) {
+      client.at_eof = true;
+   }else {
+      bytes_in += count;
+      client.input.append (block, count);
+   }
+   run_lines (client);
+}
+
+// run_lines -
+//    Runs each complete line, and a last line without a newline at
+//    end of file, while the output is below its limit.
+void shell_server::run_lines (connection& client) {
+   size_t start = 0;
+   while (not client.closing and client.output.size() < OUTPUT_LIMIT) {
+      size_t newline = client.input.find ('\n', start);
+      if (newline == string::npos) {
+         if (not client.at_eof or start == client.input.size()) break;
+         newline = client.input.size();
+      }
+      execute (client, client.input.substr (start, newline - start));
+      start = min (newline + 1, client.input.size());
+   }
+   client.input.erase (0, start);
+   if (client.input.size() > LINE_LIMIT) {
+      client.output += exec::execname() + ": line too long\n";
+      client.closing = true;
+   }
+   if (client.at_eof and client.input.empty()) client.closing = true;
+}
+
+void shell_server::execute (connection& client, const string& line) {
+   wordvec words = split (line, " \t");
+   // Ends the session without changing the server's status, unless
+   // it is a line of a here document.
+   if (client.session.here_end.empty() and not words.empty()
+       and words[0] == "exit") {
+      client.closing = true;
+      return;
+   }
+   {
+      output_capture capture (cout, client.output);
+      try {
+         if (not run_line (client.session, words).empty()) ++commands;
+      }catch (command_error& error) {
+         cout << exec::execname() << ": " << error.what() << endl;
+      }catch (file_error& error) {
+         cout << exec::execname() << ": " << error.what() << endl;
+      }
+   }
+   client.output += client.session.prompt();
+}
+
+void shell_server::transmit (connection& client) {
+   size_t sent = 0;
+   while (sent < client.output.size()) {
+      ssize_t count = send (client.fd, client.output.data() + sent,
+                            client.output.size() - sent, MSG_NOSIGNAL);
+      if (count < 0) {
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN or errno == EWOULDBLOCK) break;
+         DEBUGF ('n', "send " << client.fd << ": " << strerror (errno));
+         client.output.clear();
+         client.closing = true;
+         return;
+      }
+      sent += count;
+   }
+   client.output.erase (0, sent);
+   bytes_out += sent;
+   // Lines held back while the output was full may run now.
+   if (client.output.size() < OUTPUT_LIMIT) run_lines (client);
+}
+
+// update -
+//    Sends what it can, then closes the connection if it is done,
+//    or else waits for input while the output is below its limit,
+//    and for room to send while any is left.
+void shell_server::update (connection& client) {
+   if (not client.output.empty()) transmit (client);
+   if (client.closing and client.output.empty()) {
+      close_connection (client);
+      return;
+   }
+   uint32_t events = 0;
+   if (not client.at_eof and not client.closing
+       and client.output.size() < OUTPUT_LIMIT) events |= EPOLLIN;
+   if (not client.output.empty()) events |= EPOLLOUT;
+   if (events == client.events) return;
+   epoll_event event {};
+   event.events = events;
+   event.data.fd = client.fd;
+   int operation = client.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+   if (epoll_ctl (epoll_fd, operation, client.fd, &event) < 0) {
+      throw errno_error ("epoll");
+   }
+   client.events = events;
+}
+
+void shell_server::close_connection (connection& client) {
+   DEBUGF ('n', "close " << client.fd);
+   // Closing the socket also takes it out of the epoll set.
+   int fd = client.fd;
+   close (fd);
+   connections.erase (fd);
+}
+
+void shell_server::print_stats (ostream& out) const {
+   out << "server: " << accepted << " connections, " << commands
+       << " commands, " << bytes_in << " bytes in, " << bytes_out
+       << " bytes out" << endl;
+}
+
@@ -0,0 +1,93 @@
+// $Id: server.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// shell_server -
+//    Serves the shared tree to many clients over a Unix domain
+//    socket, so that tools need not start a shell and rebuild the
+//    tree for each request.  Each connection gets its own session
+//    (inode_state), with its own cwd and prompt.  Clients send
+//    command lines, and get back what the command printed, or the
+//    error message, followed by the session's prompt, which is also
+//    sent on connecting.  exit ends the session, not the server.
+//
+//    One thread waits on epoll for all the sockets, which are non
+//    blocking.  Each line is run through run_command as soon as it
+//    arrives, with cout captured into the connection's output, which
+//    is written as the socket accepts it.  A client whose output
+//    passes OUTPUT_LIMIT is not read from, and its waiting lines are
+//    not run, until the output drains, so a client that does not
+//    read cannot make the server buffer without bound.  A line
+//    longer than LINE_LIMIT closes the connection.
+//
+// block_signals -
+//    Blocks SIGINT and SIGTERM, which the server then reads from a
+//    signalfd to stop cleanly.  Must be called before any thread is
+//    started, since a thread that did not block them would take
+//    them and end the process.
+// ctor -
+//    Listens on the socket path.  A socket file left by a server
+//    that is no longer running is replaced.
+// run -
+//    Serves clients until SIGINT or SIGTERM.
+// dtor -
+//    Closes every connection and removes the socket file.
+//
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+#include "file_sys.h"
+
+class shell_server {
+   private:
+      struct connection {
+         int fd;
+         inode_state session;
+         string input;
+         string output;
+         bool at_eof {false};
+         bool closing {false};
+         uint32_t events {0};
+         connection (int fd_, shared_ptr<file_tree> tree):
+                     fd (fd_), session (tree) {}
+      };
+      string path;
+      shared_ptr<file_tree> tree;
+      int listen_fd {-1};
+      int epoll_fd {-1};
+      int signal_fd {-1};
+      unordered_map<int,unique_ptr<connection>> connections;
+      size_t accepted {0};
+      size_t commands {0};
+      size_t bytes_in {0};
+      size_t bytes_out {0};
+      void listen_at();
+      void watch (int fd, uint32_t events);
+      void accept_all();
+      void receive (connection& client);
+      void run_lines (connection& client);
+      void execute (connection& client, const string& line);
+      void transmit (connection& client);
+      void update (connection& client);
+      void close_connection (connection& client);
+   public:
+      static constexpr size_t LINE_LIMIT = 1 << 20;
+      static constexpr size_t OUTPUT_LIMIT = 1 << 22;
+      static void block_signals();
+      shell_server (const string& path_, shared_ptr<file_tree> tree_);
+      ~shell_server();
+      shell_server (const shell_server&) = delete;
+      shell_server& operator= (const shell_server&) = delete;
+      void run();
+      void print_stats (ostream& out) const;
+};
+
+#endif
+
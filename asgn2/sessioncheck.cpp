@@ -0,0 +1,288 @@
+// $Id: sessioncheck.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// sessioncheck -
+//    Runs sessions on several threads against one shared tree, as a
+//    server with a thread for each session would, to check the
+//    locking in run_command and to time how reads scale.
+//    First readers alone, with 1, 2, 4, ... threads up to -t, each
+//    run the same rounds of cd, ls, cat and du on a fixed subtree,
+//    and a table of threads, commands, and time goes to cout.  Then
+//    the most readers run again while one writer makes, appends to,
+//    copies and removes files beside them, and greps for them.  No
+//    reader command may fail, and the tree the writer leaves is
+//    checked.  Last, a here document is written under a journal
+//    until a checkpoint is taken while it is open, and the journal
+//    is recovered into a new tree, which must have the session's
+//    prompt and the lines written.  Failures go to cerr and set the
+//    exit status.
+//    The output of the commands themselves is thrown away.
+//
+// Options:
+//    -@flags   set debug flags
+//    -n rounds rounds for each thread (default 500)
+//    -t count  most reader threads (default one per core, at least 2)
+//
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <unistd.h>
+
+#include "commands.h"
+#include "debug.h"
+#include "file_sys.h"
+#include "journal.h"
+#include "util.h"
+
+using check_clock = chrono::steady_clock;
+
+constexpr size_t DIRECTORIES = 8;
+constexpr size_t FILES = 32;
+size_t rounds = 500;
+size_t max_readers = 0;
+atomic<size_t> failures {0};
+
+// null_output -
+//    Discards what the commands print.  It keeps no state, so the
+//    threads may all write to it at once.
+class null_output: public streambuf {
+   protected:
+      virtual int_type overflow (int_type byte) override {
+         return traits_type::not_eof (byte);
+      }
+      virtual streamsize xsputn (const char*, streamsize count)
+                                override {
+         return count;
+      }
+};
+
+// run -
+//    Runs one command, counting it as a failure if it throws.
+void run (inode_state& session, const wordvec& words) {
+   try {
+      run_command (session, words);
+   }catch (command_error& error) {
+      ++failures;
+      complain() << words << ": " << error.what() << endl;
+   }
+}
+
+// read_rounds -
+//    What each reader does:  only reads of the fixed subtree /r,
+//    none of which can fail.
+void read_rounds (shared_ptr<file_tree> tree, size_t self) {
+   inode_state session (tree);
+   for (size_t round = 0; round < rounds; ++round) {
+      string dir = "/r/d" + to_string ((round + self) % DIRECTORIES);
+      run (session, {"cd", dir});
+      run (session, {"ls"});
+      run (session, {"cat", "f" + to_string (round % FILES)});
+      run (session, {"du", dir});
+   }
+}
+
+// write_rounds -
+//    What the writer does, beside the readers, in /w.  Every fourth
+//    directory is removed again, and the rest are checked at the end
+//    by check_writes.
+void write_rounds (shared_ptr<file_tree> tree) {
+   inode_state session (tree);
+   run (session, {"mkdir", "/w"});
+   for (size_t round = 0; round < rounds; ++round) {
+      string dir = "/w/n" + to_string (round);
+      string word = "x" + to_string (round);
+      run (session, {"mkdir", dir});
+      run (session, {"make", dir + "/f", word});
+      run (session, {"append", dir + "/f", "tail"});
+      run (session, {"cp", dir + "/f", dir + "/g"});
+      run (session, {"grep", word, dir});
+      if (round % 4 == 3) run (session, {"rmr", dir});
+   }
+}
+
+void check_writes (inode_state& state) {
+   for (size_t round = 0; round < rounds; ++round) {
+      string dir = "/w/n" + to_string (round);
+      string text = "x" + to_string (round) + " tail";
+      bool removed = round % 4 == 3;
+      if ((state.get_inode_from_path (dir, false) == nullptr)
+          != removed) {
+         ++failures;
+         complain() << dir << (removed ? " not removed" : " missing")
+                    << endl;
+         continue;
+      }
+      if (removed) continue;
+      for (const char* name: {"/f", "/g"}) {
+         inode_ptr file = state.get_inode_from_path (dir + name, false);
+         if (file == nullptr or file->get_file() == nullptr
+             or file->get_file()->readfile() != text) {
+            ++failures;
+            complain() << dir << name << ": not \"" << text << "\""
+                       << endl;
+         }
+      }
+   }
+}
+
+// check_journal -
+//    Checks that a checkpoint taken inside a here document records
+//    the session's prompt, not the "> " shown while it is open.  The
+//    here document is left open, as if the shell had crashed.
+void check_journal() {
+   char directory[] = "/tmp/sessioncheck.XXXXXX";
+   if (mkdtemp (directory) == nullptr) {
+      ++failures;
+      complain() << directory << ": " << strerror (errno) << endl;
+      return;
+   }
+   string filename = string (directory) + "/journal";
+   size_t lines = journal::CHECKPOINT_RECORDS + 8;
+   string text;
+   try {
+      {
+         inode_state state;
+         journal wal (filename);
+         wal.recover (state);
+         auto log = [&] (const wordvec& words) {
+            try {
+               wordvec ran = run_line (state, words);
+               if (not ran.empty()) wal.log (state, ran);
+            }catch (command_error& error) {
+               ++failures;
+               complain() << words << ": " << error.what() << endl;
+            }
+         };
+         log ({"prompt", "check:"});
+         log ({"make", "/here", "<<end"});
+         for (size_t line = 0; line < lines; ++line) {
+            log ({"line", to_string (line)});
+         }
+         text = state.get_inode_from_path ("/here", false)
+                     ->get_file()->readfile();
+      }
+      inode_state state;
+      journal wal (filename);
+      wal.recover (state);
+      if (state.prompt() != "check: ") {
+         ++failures;
+         complain() << "prompt after recovery is \"" << state.prompt()
+                    << "\"" << endl;
+      }
+      inode_ptr file = state.get_inode_from_path ("/here", false);
+      if (file == nullptr or file->get_file() == nullptr
+          or file->get_file()->readfile() != text) {
+         ++failures;
+         complain() << "/here differs after recovery" << endl;
+      }
+   }catch (file_error& error) {
+      ++failures;
+      complain() << error.what() << endl;
+   }
+   unlink (filename.c_str());
+   unlink ((filename + ".img").c_str());
+   rmdir (directory);
+}
+
+// time_threads -
+//    Runs each function on its own thread, and returns how long
+//    they took together.
+check_clock::duration time_threads (vector<function<void()>> work) {
+   auto start = check_clock::now();
+   vector<thread> threads;
+   for (auto& each: work) threads.emplace_back (each);
+   for (thread& each: threads) each.join();
+   return check_clock::now() - start;
+}
+
+void scan_options (int argc, char** argv) {
+   opterr = 0;
+   for (;;) {
+      int option = getopt (argc, argv, "@:n:t:");
+      if (option == EOF) break;
+      switch (option) {
+         case '@':
+            debugflags::setflags (optarg);
+            break;
+         case 'n':
+            rounds = strtoul (optarg, nullptr, 10);
+            break;
+         case 't':
+            max_readers = strtoul (optarg, nullptr, 10);
+            break;
+         default:
+            complain() << "-" << static_cast<char> (optopt)
+                       << ": invalid option" << endl;
+            break;
+      }
+   }
+   if (optind < argc) complain() << "operand not permitted" << endl;
+   if (max_readers == 0) max_readers = thread::hardware_concurrency();
+   if (max_readers < 2) max_readers = 2;
+}
+
+int main (int argc, char** argv) {
+   exec::execname (argv[0]);
+   scan_options (argc, argv);
+   inode_state state;
+   run (state, {"mkdir", "/r"});
+   for (size_t dir = 0; dir < DIRECTORIES; ++dir) {
+      string path = "/r/d" + to_string (dir);
+      run (state, {"mkdir", path});
+      for (size_t file = 0; file < FILES; ++file) {
+         run (state, {"make", path + "/f" + to_string (file),
+                      "d" + to_string (dir), "f" + to_string (file)});
+      }
+   }
+
+   null_output discard;
+   streambuf* saved = cout.rdbuf (&discard);
+   vector<pair<size_t,double>> times;
+   for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+      vector<function<void()>> work;
+      for (size_t self = 0; self < readers; ++self) {
+         work.push_back ([&state, self] {
+            read_rounds (state.get_tree(), self);
+         });
+      }
+      auto elapsed = time_threads (work);
+      times.emplace_back (readers,
+            chrono::duration<double, milli> (elapsed).count());
+   }
+   vector<function<void()>> work {[&state] {
+      write_rounds (state.get_tree());
+   }};
+   for (size_t self = 0; self < max_readers; ++self) {
+      work.push_back ([&state, self] {
+         read_rounds (state.get_tree(), self);
+      });
+   }
+   time_threads (work);
+   cout.rdbuf (saved);
+
+   cout << setw (8) << "readers" << setw (10) << "commands"
+        << setw (12) << "ms" << setw (14) << "commands/ms" << endl;
+   for (const auto& [readers, ms]: times) {
+      size_t commands = readers * rounds * 4;
+      cout << setw (8) << readers << setw (10) << commands << fixed
+           << setprecision (1) << setw (12) << ms << setw (14)
+           << (ms > 0 ? commands / ms : 0) << endl;
+   }
+   state.refresh();
+   check_writes (state);
+   check_journal();
+   cout << failures << " failures" << endl;
+   return exec::status();
+}
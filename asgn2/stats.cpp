@@ -0,0 +1,64 @@
+// $Id: stats.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <cstdio>
+using namespace std;
+
+#include <malloc.h>
+
+#include "stats.h"
+
+void command_stats::record (const string& name, uint64_t micros,
+                            bool failed) {
+   auto found = table.find (name);
+   if (found == table.end()) return;
+   counters& each = found->second;
+   ++each.calls;
+   if (failed) ++each.failures;
+   each.total_us += micros;
+   uint64_t longest = each.max_us;
+   while (micros > longest
+          and not each.max_us.compare_exchange_weak (longest, micros)) {}
+   size_t bucket = 0;
+   while (bucket + 1 < BUCKETS and micros >> bucket != 0) ++bucket;
+   ++each.buckets[bucket];
+}
+
+void command_stats::print (ostream& out) const {
+   for (const auto& [name, each]: table) {
+      uint64_t calls = each.calls;
+      if (calls == 0) continue;
+      char line[128];
+      snprintf (line, sizeof line, "%-9s %8llu calls %6llu failed "
+                "%10.1f us mean %10llu us max",
+                name.c_str(), static_cast<unsigned long long> (calls),
+                static_cast<unsigned long long> (each.failures.load()),
+                static_cast<double> (each.total_us) / calls,
+                static_cast<unsigned long long> (each.max_us.load()));
+      out << line << endl;
+      out << "         ";
+      for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+         uint64_t count = each.buckets[bucket];
+         if (count == 0) continue;
+         if (bucket + 1 < BUCKETS) {
+            out << " <" << (uint64_t {1} << bucket) << "us:" << count;
+         }else {
+            out << " more:" << count;
+         }
+      }
+      out << endl;
+   }
+}
+
+command_stats::timer::~timer() {
+   auto elapsed = chrono::steady_clock::now() - start;
+   auto micros = chrono::duration_cast<chrono::microseconds> (elapsed);
+   stats.record (name, micros.count(), failed);
+}
+
+void print_malloc_stats (ostream& out) {
+   struct mallinfo2 info = mallinfo2();
+   out << "malloc: " << info.arena << " bytes in the heap, "
+       << info.hblkhd << " bytes mapped, " << info.uordblks
+       << " bytes in use, " << info.fordblks << " bytes free" << endl;
+}
+
@@ -0,0 +1,86 @@
+// $Id: stats.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// command_stats -
+//    Counts the calls of each command and how long they took, for
+//    stat.  Every command has its counters from the start, so the
+//    table never changes, and sessions on several threads record
+//    calls at once by updating atomic counters, without a lock.
+//    Times are kept in a histogram of BUCKETS buckets, bucket i
+//    holding calls that took under 2^i microseconds, and the last
+//    those that took longer.
+// ctor -
+//    Given the table of commands, whose names it takes.
+// record -
+//    Adds one call of a command, taking so many microseconds, which
+//    failed if it threw.  A name not in the table is ignored.
+// print -
+//    Prints the calls, failures, mean and longest time of each
+//    command called, in order of name, and the nonempty buckets.
+//
+// command_stats::timer -
+//    Records a call of a command, timed from its construction to its
+//    destruction, as failed unless succeeded was called.
+//
+// print_malloc_stats -
+//    Prints what the allocator has taken from the system, and how
+//    much of it is in use.
+//
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+using namespace std;
+
+class command_stats {
+   public:
+      static constexpr size_t BUCKETS = 24;
+      class timer;
+   private:
+      struct counters {
+         atomic<uint64_t> calls {0};
+         atomic<uint64_t> failures {0};
+         atomic<uint64_t> total_us {0};
+         atomic<uint64_t> max_us {0};
+         atomic<uint64_t> buckets[BUCKETS] {};
+      };
+      map<string,counters> table;
+   public:
+      template <typename command_table>
+      explicit command_stats (const command_table& commands) {
+         for (const auto& command: commands) {
+            table.try_emplace (command.first);
+         }
+      }
+      command_stats (const command_stats&) = delete;
+      command_stats& operator= (const command_stats&) = delete;
+      void record (const string& name, uint64_t micros, bool failed);
+      void print (ostream& out) const;
+};
+
+class command_stats::timer {
+   private:
+      command_stats& stats;
+      const string& name;
+      chrono::steady_clock::time_point start;
+      bool failed {true};
+   public:
+      timer (command_stats& stats_, const string& name_):
+             stats (stats_), name (name_),
+             start (chrono::steady_clock::now()) {}
+      ~timer();
+      timer (const timer&) = delete;
+      timer& operator= (const timer&) = delete;
+      void succeeded() { failed = false; }
+};
+
+void print_malloc_stats (ostream& out);
+
+#endif
+
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
 
@@ -56,6 +57,63 @@ class exec {
 
 wordvec split (const string& line, const string& delimiter);
 
+// path_components -
+//    Iterates over the components of a pathname as string_views
+//    into the pathname itself, skipping empty components, so that
+//    walking a path allocates nothing.  The pathname must outlive
+//    the iteration.  Example:
+//       for (string_view name: path_components (path)) ...
+// last -
+//    The final component, or an empty view positioned at the end of
+//    the pathname if there are no components.
+
+class path_components {
+   private:
+      string_view path;
+   public:
+      class iterator {
+         private:
+            string_view rest;
+            string_view current;
+            bool done {true};
+            void advance() {
+               size_t start = rest.find_first_not_of ('/');
+               if (start == string_view::npos) {
+                  done = true;
+                  return;
+               }
+               rest.remove_prefix (start);
+               current = rest.substr (0, rest.find ('/'));
+               rest.remove_prefix (current.size());
+               done = false;
+            }
+         public:
+            iterator() = default;
+            explicit iterator (string_view path): rest (path) {
+               advance();
+            }
+            string_view operator*() const { return current; }
+            iterator& operator++() { advance(); return *this; }
+            bool operator== (const iterator& that) const {
+               if (done or that.done) return done == that.done;
+               return current.data() == that.current.data();
+            }
+            bool operator!= (const iterator& that) const {
+               return not (*this == that);
+            }
+      };
+      explicit path_components (string_view path_): path (path_) {}
+      iterator begin() const { return iterator (path); }
+      iterator end() const { return iterator(); }
+      string_view last() const {
+         size_t end = path.find_last_not_of ('/');
+         if (end == string_view::npos) return path.substr (path.size());
+         size_t start = path.find_last_of ('/', end);
+         start = start == string_view::npos ? 0 : start + 1;
+         return path.substr (start, end + 1 - start);
+      }
+};
+
 // complain -
 //    Used for starting error messages.  Sets the exit status to
 //    EXIT_FAILURE, writes the program name to cerr, and then
@@ -0,0 +1,129 @@
+// $Id: wildcard.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include "wildcard.h"
+
+wildcard::wildcard (string_view pattern) {
+   auto add_literal = [this] (char letter) {
+      if (tokens.empty() or tokens.back().type != kind::LITERAL) {
+         tokens.push_back ({kind::LITERAL, "", {}});
+      }
+      tokens.back().text += letter;
+      literal_ += letter;
+   };
+   for (size_t at = 0; at < pattern.size(); ++at) {
+      char letter = pattern[at];
+      if (letter == '\\' and at + 1 < pattern.size()) {
+         add_literal (pattern[++at]);
+      }else if (letter == '*') {
+         is_literal_ = false;
+         if (tokens.empty() or tokens.back().type != kind::ANY_RUN) {
+            tokens.push_back ({kind::ANY_RUN, "", {}});
+         }
+      }else if (letter == '?') {
+         is_literal_ = false;
+         tokens.push_back ({kind::ANY_ONE, "", {}});
+      }else if (letter == '[') {
+         token set {kind::CHAR_SET, "", {}};
+         size_t end = at + 1;
+         bool negate = end < pattern.size()
+                   and (pattern[end] == '!' or pattern[end] == '^');
+         if (negate) ++end;
+         // A ] first in the set is just a member.
+         bool first = true;
+         for (; end < pattern.size(); ++end, first = false) {
+            unsigned char low = pattern[end];
+            if (low == ']' and not first) break;
+            unsigned char high = low;
+            if (end + 2 < pattern.size() and pattern[end + 1] == '-'
+                and pattern[end + 2] != ']') {
+               high = pattern[end + 2];
+               end += 2;
+            }
+            for (unsigned each = low; each <= high; ++each) {
+               set.chars.set (each);
+            }
+         }
+         if (end >= pattern.size()) {
+            add_literal (letter);
+            continue;
+         }
+         if (negate) set.chars.flip();
+         is_literal_ = false;
+         tokens.push_back (set);
+         at = end;
+      }else {
+         add_literal (letter);
+      }
+   }
+}
+
+bool wildcard::has_magic (string_view pattern) {
+   for (size_t at = 0; at < pattern.size(); ++at) {
+      switch (pattern[at]) {
+         case '\\': ++at; break;
+         case '*': case '?': case '[': return true;
+      }
+   }
+   return false;
+}
+
+// step -
+//    Matches one token of fixed length at a position in the name,
+//    and moves past it.
+bool wildcard::step (const token& each, string_view name,
+                     size_t& at) const {
+   switch (each.type) {
+      case kind::LITERAL:
+         if (name.compare (at, each.text.size(), each.text) != 0) {
+            return false;
+         }
+         at += each.text.size();
+         return true;
+      case kind::ANY_ONE:
+         if (at >= name.size()) return false;
+         ++at;
+         return true;
+      case kind::CHAR_SET:
+         if (at >= name.size()) return false;
+         if (not each.chars[static_cast<unsigned char> (name[at])]) {
+            return false;
+         }
+         ++at;
+         return true;
+      default:
+         return false;
+   }
+}
+
+bool wildcard::match (string_view name) const {
+   if (not name.empty() and name[0] == '.') {
+      if (tokens.empty() or tokens[0].type != kind::LITERAL
+          or tokens[0].text[0] != '.') return false;
+   }
+   size_t next = 0;
+   size_t at = 0;
+   size_t star = tokens.size();  // none yet
+   size_t star_at = 0;
+   while (next < tokens.size() or at < name.size()) {
+      if (next < tokens.size()) {
+         const token& each = tokens[next];
+         if (each.type == kind::ANY_RUN) {
+            star = next++;
+            star_at = at;
+            continue;
+         }
+         size_t after = at;
+         if (step (each, name, after)) {
+            at = after;
+            ++next;
+            continue;
+         }
+      }
+      // Let the last star take one more character and try again.
+      if (star == tokens.size() or star_at >= name.size()) return false;
+      at = ++star_at;
+      next = star + 1;
+   }
+   return true;
+}
+
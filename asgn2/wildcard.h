@@ -0,0 +1,55 @@
+// $Id: wildcard.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// wildcard -
+//    One component of a glob pattern, compiled once into a list of
+//    tokens and then matched against many names:
+//       *        any run of characters, possibly empty
+//       ?        any one character
+//       [abc]    any one of the characters listed, which may include
+//                ranges like a-z; [!...] or [^...] negates the set
+//       other    itself; a backslash quotes the next character
+//    A name starting with a dot is only matched by a pattern that
+//    starts with a literal dot.  An unterminated [ is literal.
+//    A * only needs to remember the last star to backtrack to, so
+//    a match takes O(pattern length times name length) at worst,
+//    and usually one pass.
+// has_magic -
+//    True if a pattern has any unquoted *, ?, or [.
+// is_literal, literal -
+//    A pattern with no magic matches one name, which may be looked
+//    up directly instead of matched against each entry.
+//
+
+#ifndef __WILDCARD_H__
+#define __WILDCARD_H__
+
+#include <bitset>
+#include <climits>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+class wildcard {
+   private:
+      enum class kind {LITERAL, ANY_ONE, ANY_RUN, CHAR_SET};
+      struct token {
+         kind type;
+         string text;
+         bitset<UCHAR_MAX + 1> chars;
+      };
+      vector<token> tokens;
+      string literal_;
+      bool is_literal_ {true};
+      bool step (const token& each, string_view name, size_t& at) const;
+   public:
+      explicit wildcard (string_view pattern);
+      static bool has_magic (string_view pattern);
+      bool is_literal() const { return is_literal_; }
+      const string& literal() const { return literal_; }
+      bool match (string_view name) const;
+};
+
+#endif
+
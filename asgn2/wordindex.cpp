@@ -0,0 +1,218 @@
+// $Id: wordindex.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <algorithm>
+using namespace std;
+
+#include "debug.h"
+#include "wordindex.h"
+
+static void put_varint (string& out, uint32_t number) {
+   while (number >= 0x80) {
+      out += static_cast<char> ((number & 0x7F) | 0x80);
+      number >>= 7;
+   }
+   out += static_cast<char> (number);
+}
+
+static uint32_t get_varint (const string& in, size_t& position) {
+   uint32_t number = 0;
+   for (unsigned shift = 0;; shift += 7) {
+      unsigned char byte = in[position++];
+      number |= static_cast<uint32_t> (byte & 0x7F) << shift;
+      if (byte < 0x80) return number;
+   }
+}
+
+// take -
+//    Removes a number from an unsorted list, if it is there.
+static bool take (vector<uint32_t>& list, uint32_t number) {
+   auto found = find (list.begin(), list.end(), number);
+   if (found == list.end()) return false;
+   *found = list.back();
+   list.pop_back();
+   return true;
+}
+
+void posting_list::add (uint32_t number) {
+   if (take (removed, number)) return;
+   if (added.empty() and (packed_count == 0 or number > last)) {
+      put_varint (packed, number - last);
+      last = number;
+      ++packed_count;
+      return;
+   }
+   added.push_back (number);
+   if (added.size() + removed.size() > 8 + packed_count / 8) merge();
+}
+
+void posting_list::remove (uint32_t number) {
+   if (take (added, number)) return;
+   removed.push_back (number);
+   if (added.size() + removed.size() > 8 + packed_count / 8) merge();
+}
+
+bool posting_list::contains (uint32_t number) const {
+   if (find (removed.begin(), removed.end(), number) != removed.end()) {
+      return false;
+   }
+   if (find (added.begin(), added.end(), number) != added.end()) {
+      return true;
+   }
+   if (packed_count == 0 or number > last) return false;
+   if (number == last) return true;
+   uint32_t value = 0;
+   for (size_t position = 0; position < packed.size(); ) {
+      value += get_varint (packed, position);
+      if (value >= number) return value == number;
+   }
+   return false;
+}
+
+vector<uint32_t> posting_list::values() const {
+   vector<uint32_t> result;
+   result.reserve (packed_count + added.size());
+   uint32_t number = 0;
+   for (size_t position = 0; position < packed.size(); ) {
+      number += get_varint (packed, position);
+      result.push_back (number);
+   }
+   if (not removed.empty()) {
+      vector<uint32_t> gone (removed);
+      sort (gone.begin(), gone.end());
+      auto kept = remove_if (result.begin(), result.end(),
+                             [&gone] (uint32_t value) {
+         return binary_search (gone.begin(), gone.end(), value);
+      });
+      result.erase (kept, result.end());
+   }
+   if (not added.empty()) {
+      size_t middle = result.size();
+      result.insert (result.end(), added.begin(), added.end());
+      sort (result.begin() + middle, result.end());
+      inplace_merge (result.begin(), result.begin() + middle,
+                     result.end());
+   }
+   return result;
+}
+
+void posting_list::merge() {
+   vector<uint32_t> numbers = values();
+   packed.clear();
+   last = 0;
+   for (uint32_t number: numbers) {
+      put_varint (packed, number - last);
+      last = number;
+   }
+   packed.shrink_to_fit();
+   packed_count = numbers.size();
+   added.clear();
+   removed.clear();
+}
+
+bool posting_list::empty() const {
+   return packed_count + added.size() == removed.size();
+}
+
+size_t posting_list::bytes() const {
+   return packed.capacity()
+        + (added.capacity() + removed.capacity()) * sizeof (uint32_t);
+}
+
+// distinct -
+//    Sorts the words and drops duplicates.
+static void distinct (vector<string_view>& words) {
+   sort (words.begin(), words.end());
+   words.erase (unique (words.begin(), words.end()), words.end());
+}
+
+void word_index::add (uint32_t number, inode_ptr file,
+                      const string& path, vector<string_view> words) {
+   distinct (words);
+   lock_guard<mutex> guard (lock);
+   files[number] = {number, file, path};
+   for (string_view word: words) {
+      postings[string (word)].add (number);
+   }
+}
+
+void word_index::remove (uint32_t number, inode_ptr file,
+                         vector<string_view> words) {
+   distinct (words);
+   lock_guard<mutex> guard (lock);
+   auto indexed = files.find (number);
+   if (indexed == files.end() or indexed->second.file != file) return;
+   files.erase (indexed);
+   for (string_view word: words) {
+      auto list = postings.find (string (word));
+      if (list == postings.end()) continue;
+      list->second.remove (number);
+      if (list->second.empty()) postings.erase (list);
+   }
+}
+
+void word_index::extend (uint32_t number, inode_ptr file,
+                         vector<string_view> words) {
+   distinct (words);
+   lock_guard<mutex> guard (lock);
+   auto indexed = files.find (number);
+   if (indexed == files.end() or indexed->second.file != file) return;
+   for (string_view word: words) {
+      posting_list& list = postings[string (word)];
+      if (not list.contains (number)) list.add (number);
+   }
+}
+
+void word_index::rename (uint32_t number, inode_ptr file,
+                         const string& path) {
+   lock_guard<mutex> guard (lock);
+   auto indexed = files.find (number);
+   if (indexed == files.end() or indexed->second.file != file) return;
+   indexed->second.path = path;
+}
+
+vector<indexed_file> word_index::find (const string& word) const {
+   vector<indexed_file> result;
+   lock_guard<mutex> guard (lock);
+   auto list = postings.find (word);
+   if (list == postings.end()) return result;
+   for (uint32_t number: list->second.values()) {
+      auto file = files.find (number);
+      if (file == files.end()) {
+         result.push_back ({number, nullptr, {}});
+      }else {
+         result.push_back (file->second);
+      }
+   }
+   return result;
+}
+
+void word_index::prune (const string& word, uint32_t number,
+                        inode_ptr file) {
+   lock_guard<mutex> guard (lock);
+   auto indexed = files.find (number);
+   if (indexed != files.end()) {
+      if (indexed->second.file != file) return;
+      files.erase (indexed);
+   }
+   auto list = postings.find (word);
+   if (list == postings.end()) return;
+   list->second.remove (number);
+   if (list->second.empty()) postings.erase (list);
+   DEBUGF ('g', "pruned " << number << " from " << word);
+}
+
+void word_index::clear() {
+   lock_guard<mutex> guard (lock);
+   postings.clear();
+   files.clear();
+}
+
+void word_index::print_stats (ostream& out) const {
+   lock_guard<mutex> guard (lock);
+   size_t bytes = 0;
+   for (const auto& list: postings) bytes += list.second.bytes();
+   out << "word index: " << postings.size() << " words, "
+       << files.size() << " files, " << bytes << " posting bytes"
+       << endl;
+}
+
@@ -0,0 +1,103 @@
+// $Id: wordindex.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// posting_list -
+//    The sorted inode numbers of the files containing one word.  The
+//    numbers are stored as the differences between neighbors, each
+//    in a variable length code of 7 bits per byte, so a list of
+//    nearby numbers costs about one byte each.  New files get the
+//    highest numbers so far, which are just appended.  Any other
+//    change is kept in small unsorted added and removed lists, which
+//    are merged into the packed list when they grow past an eighth
+//    of its size, so changes cost O(1) amortized.
+// add, remove -
+//    A number must not be added twice or removed if not present.
+// contains -
+//    Whether a number is present.  O(1) for the highest number,
+//    which a file just made has, and otherwise a scan.
+// values -
+//    The numbers in order, with the changes applied.
+//
+// word_index -
+//    An inverted index from each word to the files containing it,
+//    with the file inode for each inode number, and the path it had
+//    in the live tree when it was indexed, since inodes do not know
+//    where they are.  It may be changed from the reclaimer's thread
+//    as well, so each function locks.
+// add, remove -
+//    Index or unindex the words of a file.  Duplicate words count
+//    once.  Removing a file whose number now names another inode
+//    does nothing.
+// extend -
+//    Indexes words appended to an indexed file, those it did not
+//    already contain.
+// rename -
+//    Records the new path of a file that was moved.
+// find -
+//    The inode number, inode and path of each file containing a
+//    word.  A file may since have been removed or moved, so the
+//    caller must check that the path still names it.
+// prune -
+//    Removes a file from one word's list, and forgets the file, when
+//    find returned one that is no longer in the tree.
+//
+
+#ifndef __WORDINDEX_H__
+#define __WORDINDEX_H__
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "dirents.h"
+
+class posting_list {
+   private:
+      string packed;
+      size_t packed_count {0};
+      uint32_t last {0};
+      vector<uint32_t> added;
+      vector<uint32_t> removed;
+      void merge();
+   public:
+      void add (uint32_t number);
+      void remove (uint32_t number);
+      bool contains (uint32_t number) const;
+      vector<uint32_t> values() const;
+      bool empty() const;
+      size_t bytes() const;
+};
+
+struct indexed_file {
+   uint32_t number;
+   inode_ptr file;
+   string path;
+};
+
+class word_index {
+   private:
+      mutable mutex lock;
+      unordered_map<string,posting_list> postings;
+      unordered_map<uint32_t,indexed_file> files;
+   public:
+      void add (uint32_t number, inode_ptr file, const string& path,
+                vector<string_view> words);
+      void remove (uint32_t number, inode_ptr file,
+                   vector<string_view> words);
+      void extend (uint32_t number, inode_ptr file,
+                   vector<string_view> words);
+      void rename (uint32_t number, inode_ptr file, const string& path);
+      vector<indexed_file> find (const string& word) const;
+      void prune (const string& word, uint32_t number, inode_ptr file);
+      void clear();
+      void print_stats (ostream& out) const;
+};
+
+#endif
+
@@ -0,0 +1,129 @@
+// $Id: workers.cpp,v 1.1 2026-10-19 12:00:00-07 - - $
+
+#include <thread>
+using namespace std;
+
+#include "debug.h"
+#include "workers.h"
+
+// The index of the worker running on this thread, for spawn.
+static thread_local size_t this_worker = 0;
+
+work_pool::work_pool (size_t thread_count) {
+   if (thread_count == 0) thread_count = thread::hardware_concurrency();
+   if (thread_count == 0) thread_count = 1;
+   for (size_t count = 0; count < thread_count; ++count) {
+      workers.push_back (make_unique<worker>());
+   }
+   for (size_t self = 1; self < workers.size(); ++self) {
+      helpers.emplace_back (&work_pool::serve, this, self);
+   }
+}
+
+work_pool::~work_pool() {
+   {
+      lock_guard<mutex> guard (idle_lock);
+      stopping = true;
+   }
+   idle.notify_all();
+   for (thread& helper: helpers) helper.join();
+}
+
+bool work_pool::take (size_t self, task& next) {
+   {
+      worker& own = *workers[self];
+      lock_guard<mutex> guard (own.lock);
+      if (not own.tasks.empty()) {
+         next = move (own.tasks.back());
+         own.tasks.pop_back();
+         --queued;
+         return true;
+      }
+   }
+   for (size_t offset = 1; offset < workers.size(); ++offset) {
+      worker& victim = *workers[(self + offset) % workers.size()];
+      lock_guard<mutex> guard (victim.lock);
+      if (not victim.tasks.empty()) {
+         next = move (victim.tasks.front());
+         victim.tasks.pop_front();
+         --queued;
+         ++workers[self]->stolen;
+         return true;
+      }
+   }
+   return false;
+}
+
+void work_pool::execute (size_t self, task& next) {
+   try {
+      next();
+   }catch (...) {
+      lock_guard<mutex> guard (error_lock);
+      if (not error) error = current_exception();
+   }
+   next = nullptr;
+   ++workers[self]->executed;
+   if (--unfinished == 0) {
+      // The thread in run may be asleep waiting for this.
+      lock_guard<mutex> guard (idle_lock);
+      idle.notify_all();
+   }
+}
+
+void work_pool::serve (size_t self) {
+   this_worker = self;
+   task next;
+   for (;;) {
+      if (take (self, next)) {
+         execute (self, next);
+         continue;
+      }
+      unique_lock<mutex> guard (idle_lock);
+      idle.wait (guard, [this] { return stopping or queued > 0; });
+      if (stopping) return;
+   }
+}
+
+void work_pool::run (task first) {
+   lock_guard<mutex> running (run_lock);
+   this_worker = 0;
+   spawn (move (first));
+   task next;
+   for (;;) {
+      if (take (0, next)) {
+         execute (0, next);
+         continue;
+      }
+      unique_lock<mutex> guard (idle_lock);
+      idle.wait (guard, [this] { return unfinished == 0 or queued > 0; });
+      if (unfinished == 0) break;
+   }
+   DEBUGS ('w', print_stats (cerr));
+   if (error) {
+      exception_ptr thrown = error;
+      error = nullptr;
+      rethrow_exception (thrown);
+   }
+}
+
+void work_pool::spawn (task next) {
+   ++unfinished;
+   {
+      lock_guard<mutex> guard (idle_lock);
+      ++queued;
+   }
+   {
+      worker& own = *workers[this_worker];
+      lock_guard<mutex> guard (own.lock);
+      own.tasks.push_back (move (next));
+   }
+   idle.notify_one();
+}
+
+void work_pool::print_stats (ostream& out) const {
+   out << "work_pool:";
+   for (const auto& each: workers) {
+      out << " " << each->executed << "(" << each->stolen << ")";
+   }
+   out << " tasks(stolen)" << endl;
+}
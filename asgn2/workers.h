@@ -0,0 +1,83 @@
+// $Id: workers.h,v 1.1 2026-10-19 12:00:00-07 - - $
+
+//
+// work_pool -
+//    Runs a tree of tasks on several threads by work stealing.  Each
+//    worker has its own deque of tasks.  A task spawned by a worker
+//    goes on the back of that worker's deque, and the worker takes
+//    its next task from the back, so it works depth first on what it
+//    just made.  A worker whose deque is empty steals from the front
+//    of another's, which takes the oldest task, usually the root of
+//    the largest piece of work left.
+//    The other workers' threads are started once, by the ctor, and
+//    kept for every run.  A worker with nothing to take sleeps on
+//    idle until a task is spawned, or the pool is destroyed.
+// ctor -
+//    The number of workers, counting the thread calling run.  Zero
+//    means one per core.
+// run -
+//    Runs a task, and all tasks it spawns, and returns when they are
+//    all done.  The calling thread is worker 0, and sleeps on idle
+//    like the others while it has nothing to take.  Runs from
+//    several threads take turns.  An exception thrown by a task is
+//    rethrown by run, after the other tasks finish.
+// spawn -
+//    Called by a running task to add another task.
+// queued -
+//    The number of tasks in the deques, counted before each is added,
+//    and changed under idle_lock, so a worker cannot miss one.
+// print_stats -
+//    The tasks each worker has run, and stolen, over every run.
+//
+
+#ifndef __WORKERS_H__
+#define __WORKERS_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class work_pool {
+   public:
+      using task = function<void()>;
+   private:
+      struct worker {
+         mutex lock;
+         deque<task> tasks;
+         size_t executed {0};
+         size_t stolen {0};
+      };
+      vector<unique_ptr<worker>> workers;
+      vector<thread> helpers;
+      mutex run_lock;
+      mutex idle_lock;
+      condition_variable idle;
+      atomic<size_t> queued {0};
+      atomic<size_t> unfinished {0};
+      bool stopping {false};
+      mutex error_lock;
+      exception_ptr error;
+      bool take (size_t self, task& next);
+      void execute (size_t self, task& next);
+      void serve (size_t self);
+   public:
+      explicit work_pool (size_t thread_count = 0);
+      ~work_pool();
+      work_pool (const work_pool&) = delete;
+      work_pool& operator= (const work_pool&) = delete;
+      size_t size() const { return workers.size(); }
+      void run (task first);
+      void spawn (task next);
+      void print_stats (ostream& out) const;
+};
+
+#endif
+